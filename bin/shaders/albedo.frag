@@ -1,14 +1,21 @@
 # version 460 core
+# extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 fragNormal;
 layout(location = 1) in vec2 fragTexcood;
 
 layout(location = 0) out vec4 FragColor;
 
-layout(set = 0, binding = 1) uniform sampler2D image;
+// Bindless textures, the material picks one by index
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+layout(push_constant) uniform Material
+{
+    layout(offset = 64) uint textureIndex;
+} material;
 
 void main()
 {
-    vec3 color = texture(image, fragTexcood).rgb;
+    vec3 color = texture(textures[material.textureIndex], fragTexcood).rgb;
     FragColor = vec4(color, 1.f);
 }
\ No newline at end of file
@@ -14,9 +14,26 @@ layout(set = 0, binding = 0) uniform Matrices
     mat4 projection;
 } matrices;
 
+// Per-draw transform, read from the dynamic uniform ring or from push constants
+layout(constant_id = 0) const bool perDrawPushConstants = false;
+
+layout(set = 0, binding = 1) uniform DrawData
+{
+    mat4 model;
+} drawData;
+
+layout(push_constant) uniform Draw
+{
+    mat4 model;
+} draw;
+
+// depth.vert writes the same positions in the pre-pass
+invariant gl_Position;
+
 void main()
 {
-    gl_Position = matrices.projection * matrices.view * matrices.model * vec4(aPos, 1.f);
+    mat4 objectModel = perDrawPushConstants ? draw.model : drawData.model;
+    gl_Position = matrices.projection * matrices.view * matrices.model * objectModel * vec4(aPos, 1.f);
     vertexNormal = aNormal;
     vertexTexcoord = aTexCoord;
 }
\ No newline at end of file
@@ -1,6 +0,0 @@
-D:/VulkanSDK/1.3.268.0/Bin/glslc.exe albedo.vert -o albedo_vert.spv
-D:/VulkanSDK/1.3.268.0/Bin/glslc.exe albedo.frag -o albedo_frag.spv
-D:/VulkanSDK/1.3.268.0/Bin/glslc.exe updateParticle.comp -o updateParticle_comp.spv
-D:/VulkanSDK/1.3.268.0/Bin/glslc.exe particles.vert -o particles_vert.spv
-D:/VulkanSDK/1.3.268.0/Bin/glslc.exe particles.frag -o particles_frag.spv
-pause
\ No newline at end of file
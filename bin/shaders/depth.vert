@@ -0,0 +1,31 @@
+# version 460 core
+
+// Depth pre-pass, positions only. Computes gl_Position exactly like albedo.vert so the color pass can test EQUAL.
+layout(location = 0) in vec3 aPos;
+
+layout(set = 0, binding = 0) uniform Matrices
+{
+    mat4 model;
+    mat4 view;
+    mat4 projection;
+} matrices;
+
+layout(constant_id = 0) const bool perDrawPushConstants = false;
+
+layout(set = 0, binding = 1) uniform DrawData
+{
+    mat4 model;
+} drawData;
+
+layout(push_constant) uniform Draw
+{
+    mat4 model;
+} draw;
+
+invariant gl_Position;
+
+void main()
+{
+    mat4 objectModel = perDrawPushConstants ? draw.model : drawData.model;
+    gl_Position = matrices.projection * matrices.view * matrices.model * objectModel * vec4(aPos, 1.f);
+}
\ No newline at end of file
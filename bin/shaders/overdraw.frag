@@ -0,0 +1,9 @@
+# version 460 core
+
+layout(location = 0) out vec4 FragColor;
+
+// Every shaded fragment adds the same amount, additive blending sums them up into an overdraw heat map
+void main()
+{
+    FragColor = vec4(0.1f, 0.04f, 0.02f, 1.f);
+}
\ No newline at end of file
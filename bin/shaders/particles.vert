@@ -2,6 +2,7 @@
 
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec4 aColor;
+layout(location = 2) in vec3 aPrevPos;
 
 layout(location = 0) out vec4 particleColor;
 
@@ -12,9 +13,16 @@ layout(set = 0, binding = 0) uniform Matrices
     mat4 projection;
 } matrices;
 
+layout(set = 0, binding = 1) uniform ParticleUBO
+{
+    float deltaTime;
+    int particleCount;
+    float interpolationAlpha;
+} particleUBO;
+
 void main()
 {
-    gl_Position = matrices.projection * matrices.view * matrices.model * vec4(aPos, 1.f);
+    gl_Position = matrices.projection * matrices.view * matrices.model * vec4(mix(aPrevPos, aPos, particleUBO.interpolationAlpha), 1.f);
     particleColor = aColor;
 
     gl_PointSize = 4.0f;
@@ -0,0 +1,9 @@
+# Turns a SPIR-V binary into a header with a constexpr word array, run as
+# cmake -DINPUT=<file.spv> -DOUTPUT=<file.h> -DVARIABLE=<name> -P EmbedSpirv.cmake
+file(READ ${INPUT} SPIRV_HEX HEX)
+# SPIR-V is a stream of little-endian 32-bit words
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1, " SPIRV_WORDS "${SPIRV_HEX}")
+string(REPEAT "0x........, " 8 SPIRV_LINE)  # CMake regexes have no {n} quantifier
+string(REGEX REPLACE "(${SPIRV_LINE})" "\\1\n    " SPIRV_WORDS "${SPIRV_WORDS}")
+get_filename_component(SPIRV_NAME ${INPUT} NAME)
+file(WRITE ${OUTPUT} "# pragma once\n\n// Generated from ${SPIRV_NAME} at build time, do not edit\n#include <cstdint>\n\ninline constexpr uint32_t ${VARIABLE}[] = {\n    ${SPIRV_WORDS}\n};")
\ No newline at end of file
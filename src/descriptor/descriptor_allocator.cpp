@@ -0,0 +1,87 @@
+#include "descriptor_allocator.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+DescriptorAllocator::DescriptorAllocator(VkDevice device, uint32_t initialSetsPerPool, PoolRatios poolRatios)
+    : m_device(device), m_poolRatios(std::move(poolRatios)), m_setsPerPool(initialSetsPerPool)
+{
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout descriptorSetLayout)
+{
+    std::vector<VkDescriptorSet> descriptorSets;
+    allocate({descriptorSetLayout}, descriptorSets);
+    return descriptorSets[0];
+}
+
+void DescriptorAllocator::allocate(const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts, std::vector<VkDescriptorSet>& descriptorSets)
+{
+    uint32_t setCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+    descriptorSets.resize(setCount);
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .descriptorPool = VK_NULL_HANDLE,
+        .descriptorSetCount = setCount,
+        .pSetLayouts = descriptorSetLayouts.data()
+    };
+    while(true)
+    {
+        bool freshPool = m_readyPools.empty();
+        uint32_t freshPoolSize = std::max(m_setsPerPool, setCount);
+        descriptorSetAllocateInfo.descriptorPool = acquirePool(setCount);
+        VkResult result = vkAllocateDescriptorSets(m_device, &descriptorSetAllocateInfo, descriptorSets.data());
+        if(result == VK_SUCCESS)
+            return;
+        if(result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+            break;
+        // Retire the exhausted pool and retry from the next one, which keeps growing until the request fits
+        m_fullPools.push_back(m_readyPools.back());
+        m_readyPools.pop_back();
+        if(freshPool && freshPoolSize >= m_maxSetsPerPool)
+            break;
+    }
+    throw std::runtime_error("VK ERROR: Failed to allocate VkDescriptorSet.");
+}
+
+void DescriptorAllocator::cleanUp()
+{
+    for(VkDescriptorPool descriptorPool: m_readyPools)
+        vkDestroyDescriptorPool(m_device, descriptorPool, VK_NULL_HANDLE);
+    for(VkDescriptorPool descriptorPool: m_fullPools)
+        vkDestroyDescriptorPool(m_device, descriptorPool, VK_NULL_HANDLE);
+    m_readyPools.clear();
+    m_fullPools.clear();
+}
+
+VkDescriptorPool DescriptorAllocator::acquirePool(uint32_t minSetCount)
+{
+    if(m_readyPools.empty())
+    {
+        m_readyPools.push_back(createPool(std::max(m_setsPerPool, minSetCount)));
+        m_setsPerPool = std::min(m_setsPerPool * 2, m_maxSetsPerPool);
+    }
+    return m_readyPools.back();
+}
+
+VkDescriptorPool DescriptorAllocator::createPool(uint32_t setCount) const
+{
+    std::vector<VkDescriptorPoolSize> descriptorPoolSizes;
+    for(const auto& [descriptorType, ratio]: m_poolRatios)
+        descriptorPoolSizes.push_back({descriptorType, std::max(1u, static_cast<uint32_t>(std::ceil(ratio * setCount)))});
+
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = 0,
+        .maxSets = setCount,
+        .poolSizeCount = static_cast<uint32_t>(descriptorPoolSizes.size()),
+        .pPoolSizes = descriptorPoolSizes.data(),
+    };
+    VkDescriptorPool descriptorPool;
+    if(vkCreateDescriptorPool(m_device, &descriptorPoolCreateInfo, VK_NULL_HANDLE, &descriptorPool) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to create descriptor pool.");
+    return descriptorPool;
+}
\ No newline at end of file
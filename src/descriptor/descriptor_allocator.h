@@ -0,0 +1,31 @@
+# pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <utility>
+
+// Hands out descriptor sets from a list of pools. A pool that runs out is retired and the next one, each twice as
+// large as the last and at least as large as the request, is created on demand. Sets are never freed one by one, they live until cleanUp().
+class DescriptorAllocator
+{
+public:
+    // Descriptors of each type reserved per set when sizing a new pool
+    using PoolRatios = std::vector<std::pair<VkDescriptorType, float>>;
+
+    DescriptorAllocator(VkDevice device, uint32_t initialSetsPerPool, PoolRatios poolRatios);
+    VkDescriptorSet allocate(VkDescriptorSetLayout descriptorSetLayout);
+    void allocate(const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts, std::vector<VkDescriptorSet>& descriptorSets);
+    void cleanUp();
+    uint32_t poolCount() const { return static_cast<uint32_t>(m_fullPools.size() + m_readyPools.size()); }
+private:
+    VkDescriptorPool acquirePool(uint32_t minSetCount);
+    VkDescriptorPool createPool(uint32_t setCount) const;
+
+    VkDevice m_device;
+    PoolRatios m_poolRatios;
+    uint32_t m_setsPerPool;  // Size of the next pool created, doubles up to m_maxSetsPerPool
+    uint32_t m_maxSetsPerPool = 4096;
+    std::vector<VkDescriptorPool> m_fullPools,  // Ran out of memory
+        m_readyPools;  // Still have room, the back one is allocated from
+};
\ No newline at end of file
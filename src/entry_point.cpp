@@ -4,12 +4,12 @@
 #include <stdexcept>
 #include <cstdlib>
 
-int main()
+int main(int argc, char** argv)
 {
     VulkanApp app;
     try
     {
-        app.run();
+        app.run(argc, argv);
     }
     catch(const std::exception& e)
     {
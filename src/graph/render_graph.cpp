@@ -0,0 +1,568 @@
+#include "render_graph.h"
+#include "../resources.h"
+#include "../vulkan_fn.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include <iostream>
+
+namespace
+{
+    struct AccessInfo
+    {
+        VkImageLayout layout;
+        VkPipelineStageFlags2KHR stages;
+        VkAccessFlags2KHR access;
+    };
+
+    constexpr VkAccessFlags2KHR writeAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR |
+        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR | VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR;
+
+    AccessInfo accessInfo(RenderGraphAccess access)
+    {
+        switch(access)
+        {
+        case RenderGraphAccess::ColorAttachment:
+            return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+                VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR};
+        case RenderGraphAccess::ResolveAttachment:
+            return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+                VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR};
+        case RenderGraphAccess::DepthAttachment:
+            return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 
+                VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR};
+        case RenderGraphAccess::DepthAttachmentRead:
+            return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, 
+                VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR};
+        case RenderGraphAccess::SampledRead:
+            return {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR,
+                VK_ACCESS_2_SHADER_SAMPLED_READ_BIT_KHR};
+        case RenderGraphAccess::TransferSrc:
+            return {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR};
+        case RenderGraphAccess::TransferDst:
+            return {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR};
+        }
+        throw std::runtime_error("VK ERROR: Unknown render graph access.");
+    }
+
+    VkImageMemoryBarrier2KHR imageBarrier(VkImage image, VkImageAspectFlags aspect, 
+        VkImageLayout oldLayout, VkImageLayout newLayout,
+        VkPipelineStageFlags2KHR srcStage, VkAccessFlags2KHR srcAccess,
+        VkPipelineStageFlags2KHR dstStage, VkAccessFlags2KHR dstAccess)
+    {
+        return {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR,
+            .pNext = VK_NULL_HANDLE,
+            .srcStageMask = srcStage,
+            .srcAccessMask = srcAccess,
+            .dstStageMask = dstStage,
+            .dstAccessMask = dstAccess,
+            .oldLayout = oldLayout,
+            .newLayout = newLayout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = {
+                .aspectMask = aspect,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            }
+        };
+    }
+
+    void cmdPipelineBarriers(VkCommandBuffer commandBuffer, const std::vector<VkImageMemoryBarrier2KHR>& imageBarriers)
+    {
+        if(imageBarriers.empty())
+            return;
+        VkDependencyInfoKHR dependencyInfo = {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+            .imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size()),
+            .pImageMemoryBarriers = imageBarriers.data()
+        };
+        vkCmdPipelineBarrier2KHR(commandBuffer, &dependencyInfo);
+    }
+}
+
+bool RenderGraphImageDesc::operator==(const RenderGraphImageDesc& other) const
+{
+    return format == other.format && extent.width == other.extent.width && extent.height == other.extent.height &&
+        sampleCount == other.sampleCount && usage == other.usage && aspect == other.aspect;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::color(ResourceHandle image, VkAttachmentLoadOp loadOp, VkAttachmentStoreOp storeOp,
+    VkClearColorValue clearValue, ResourceHandle resolveImage)
+{
+    m_colorAttachments.push_back({image, loadOp, storeOp, {.color = clearValue}, resolveImage});
+    use(image, RenderGraphAccess::ColorAttachment, loadOp == VK_ATTACHMENT_LOAD_OP_LOAD, true);
+    if(resolveImage != InvalidHandle)
+        use(resolveImage, RenderGraphAccess::ResolveAttachment, false, true);
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::depth(ResourceHandle image, VkAttachmentLoadOp loadOp, VkAttachmentStoreOp storeOp,
+    float clearDepth, bool write)
+{
+    m_depthAttachment = {image, loadOp, storeOp, {.depthStencil = {.depth = clearDepth, .stencil = 0}}, InvalidHandle};
+    m_depthWrite = write;
+    if(write)
+        use(image, RenderGraphAccess::DepthAttachment, loadOp == VK_ATTACHMENT_LOAD_OP_LOAD, true);
+    else
+        use(image, RenderGraphAccess::DepthAttachmentRead, true, false);
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::read(ResourceHandle image, RenderGraphAccess access)
+{
+    use(image, access, true, false);
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::write(ResourceHandle image, RenderGraphAccess access)
+{
+    use(image, access, false, true);
+    return *this;
+}
+
+void RenderGraph::Pass::use(ResourceHandle image, RenderGraphAccess access, bool read, bool write)
+{
+    if(image >= m_graph->m_images.size())
+        throw std::runtime_error("VK ERROR: Render graph pass '" + m_name + "' uses an unknown image.");
+
+    AccessInfo info = accessInfo(access);
+    for(Use& existing: m_uses)
+    {
+        if(existing.image != image)
+            continue;
+        // An image is in one layout for the whole pass, further uses only widen the synchronization scope
+        if(existing.layout != info.layout)
+            throw std::runtime_error("VK ERROR: Render graph pass '" + m_name + "' uses image '" + 
+                m_graph->m_images[image].name + "' in two layouts.");
+        existing.stages |= info.stages;
+        existing.access |= info.access;
+        existing.read = existing.read || read;
+        existing.write = existing.write || write;
+        return;
+    }
+    m_uses.push_back({image, info.layout, info.stages, info.access, read, write});
+}
+
+RenderGraph::RenderGraph(VkDevice device)
+    : m_device(device)
+{
+}
+
+void RenderGraph::reset()
+{
+    m_images.clear();
+    m_passes.clear();
+}
+
+RenderGraph::ResourceHandle RenderGraph::importImage(const std::string& name, VkImage image, VkImageView imageView, 
+    VkImageAspectFlags aspect, VkExtent2D extent, VkImageLayout initialLayout, VkPipelineStageFlags2KHR initialStage, VkImageLayout finalLayout)
+{
+    Image importedImage = {
+        .name = name,
+        .imported = true,
+        .desc = {VK_FORMAT_UNDEFINED, extent, VK_SAMPLE_COUNT_1_BIT, 0, aspect},
+        .image = image,
+        .imageView = imageView,
+        .finalLayout = finalLayout,
+        .state = {initialLayout, initialStage, VK_ACCESS_2_NONE_KHR, VK_PIPELINE_STAGE_2_NONE_KHR, VK_PIPELINE_STAGE_2_NONE_KHR},
+        .firstPass = InvalidHandle,
+        .lastPass = InvalidHandle,
+        .physicalIndex = InvalidHandle
+    };
+    m_images.push_back(importedImage);
+    return static_cast<ResourceHandle>(m_images.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::createImage(const std::string& name, const RenderGraphImageDesc& desc)
+{
+    Image transientImage = {
+        .name = name,
+        .imported = false,
+        .desc = desc,
+        .image = VK_NULL_HANDLE,
+        .imageView = VK_NULL_HANDLE,
+        .finalLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .state = {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_NONE_KHR, VK_ACCESS_2_NONE_KHR, VK_PIPELINE_STAGE_2_NONE_KHR, VK_PIPELINE_STAGE_2_NONE_KHR},
+        .firstPass = InvalidHandle,
+        .lastPass = InvalidHandle,
+        .physicalIndex = InvalidHandle
+    };
+    m_images.push_back(transientImage);
+    return static_cast<ResourceHandle>(m_images.size() - 1);
+}
+
+RenderGraph::Pass& RenderGraph::addPass(const std::string& name, std::function<void(VkCommandBuffer)> execute)
+{
+    Pass& pass = m_passes.emplace_back();
+    pass.m_graph = this;
+    pass.m_name = name;
+    pass.m_execute = std::move(execute);
+    return pass;
+}
+
+void RenderGraph::compile()
+{
+    cull();
+
+    // Lifetimes of the transient images, in pass order
+    for(uint32_t passIndex = 0; passIndex < m_passes.size(); ++passIndex)
+    {
+        if(m_passes[passIndex].m_culled)
+            continue;
+        for(const Pass::Use& use: m_passes[passIndex].m_uses)
+        {
+            Image& image = m_images[use.image];
+            if(image.firstPass == InvalidHandle)
+                image.firstPass = passIndex;
+            image.lastPass = passIndex;
+        }
+    }
+    allocateTransients();
+}
+
+void RenderGraph::cull()
+{
+    // Walk back from what leaves the frame: imported images and passes with side effects. A pass survives if it writes
+    // an image a surviving pass reads later, or one that leaves the frame.
+    std::vector<bool> needed(m_images.size(), false);
+    for(uint32_t i = 0; i < m_images.size(); ++i)
+        needed[i] = m_images[i].imported;
+
+    m_culledPassCount = 0;
+    for(auto pass = m_passes.rbegin(); pass != m_passes.rend(); ++pass)
+    {
+        bool live = pass->m_sideEffect;
+        for(const Pass::Use& use: pass->m_uses)
+            live = live || (use.write && needed[use.image]);
+        pass->m_culled = !live;
+        if(!live)
+        {
+            ++m_culledPassCount;
+            continue;
+        }
+        for(const Pass::Use& use: pass->m_uses)
+        {
+            if(use.read)
+                needed[use.image] = true;
+        }
+    }
+}
+
+void RenderGraph::allocateTransients()
+{
+    std::vector<uint32_t> transients;
+    for(uint32_t i = 0; i < m_images.size(); ++i)
+    {
+        if(!m_images[i].imported && m_images[i].firstPass != InvalidHandle)
+            transients.push_back(i);
+    }
+
+    // Keep the physical images as long as the frame declares the same transients with the same lifetimes
+    bool matches = transients.size() == m_physicalImages.size();
+    for(uint32_t i = 0; matches && i < transients.size(); ++i)
+    {
+        const Image& image = m_images[transients[i]];
+        const PhysicalImage& physicalImage = m_physicalImages[i];
+        matches = image.desc == physicalImage.desc && image.firstPass == physicalImage.firstPass && image.lastPass == physicalImage.lastPass;
+    }
+    if(!matches)
+    {
+        releaseTransients();
+
+        Resources* resources = Resources::get();
+        m_unaliasedMemorySize = 0;
+        for(uint32_t index: transients)
+        {
+            const Image& image = m_images[index];
+            VkImageCreateInfo imageCreateInfo = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                .pNext = VK_NULL_HANDLE,
+                .flags = 0,
+                .imageType = VK_IMAGE_TYPE_2D,
+                .format = image.desc.format,
+                .extent = {image.desc.extent.width, image.desc.extent.height, 1},
+                .mipLevels = 1,
+                .arrayLayers = 1,
+                .samples = image.desc.sampleCount,
+                .tiling = VK_IMAGE_TILING_OPTIMAL,
+                .usage = image.desc.usage,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                .queueFamilyIndexCount = 0,
+                .pQueueFamilyIndices = VK_NULL_HANDLE,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+            };
+            PhysicalImage physicalImage = {image.desc, image.firstPass, image.lastPass, VK_NULL_HANDLE, VK_NULL_HANDLE, {}, false, InvalidHandle};
+            if(vkCreateImage(m_device, &imageCreateInfo, VK_NULL_HANDLE, &physicalImage.image) != VK_SUCCESS)
+                throw std::runtime_error("VK ERROR: Failed to create render graph image '" + image.name + "'.");
+            vkGetImageMemoryRequirements(m_device, physicalImage.image, &physicalImage.memoryRequirements);
+
+            // Attachments whose contents never leave the tile can live in lazily allocated memory, where the device has it
+            physicalImage.lazy = (image.desc.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) && 
+                resources->tryFindMemoryTypeIndex(physicalImage.memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT).has_value();
+            m_unaliasedMemorySize += physicalImage.memoryRequirements.size;
+            m_physicalImages.push_back(physicalImage);
+        }
+
+        // Largest first, each image goes to the first block whose images are all dead before it is born or born after it dies
+        std::vector<uint32_t> order(m_physicalImages.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+        {
+            return m_physicalImages[a].memoryRequirements.size > m_physicalImages[b].memoryRequirements.size;
+        });
+        for(uint32_t index: order)
+        {
+            PhysicalImage& physicalImage = m_physicalImages[index];
+            for(uint32_t block = 0; block < m_memoryBlocks.size() && physicalImage.block == InvalidHandle; ++block)
+            {
+                if(!(m_memoryBlocks[block].memoryTypeBits & physicalImage.memoryRequirements.memoryTypeBits) || 
+                    m_memoryBlocks[block].lazy != physicalImage.lazy)
+                    continue;
+                bool overlaps = std::any_of(m_physicalImages.begin(), m_physicalImages.end(), [&](const PhysicalImage& other)
+                {
+                    return other.block == block && other.firstPass <= physicalImage.lastPass && physicalImage.firstPass <= other.lastPass;
+                });
+                if(!overlaps)
+                    physicalImage.block = block;
+            }
+            if(physicalImage.block == InvalidHandle)
+            {
+                physicalImage.block = static_cast<uint32_t>(m_memoryBlocks.size());
+                m_memoryBlocks.push_back({VK_NULL_HANDLE, 0, ~0u, physicalImage.lazy, VK_PIPELINE_STAGE_2_NONE_KHR, VK_ACCESS_2_NONE_KHR});
+            }
+            MemoryBlock& memoryBlock = m_memoryBlocks[physicalImage.block];
+            memoryBlock.size = std::max(memoryBlock.size, physicalImage.memoryRequirements.size);
+            memoryBlock.memoryTypeBits &= physicalImage.memoryRequirements.memoryTypeBits;
+        }
+
+        m_transientMemorySize = 0;
+        m_lazyMemorySize = 0;
+        for(MemoryBlock& memoryBlock: m_memoryBlocks)
+        {
+            VkMemoryAllocateInfo memoryAllocateInfo = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+                .pNext = VK_NULL_HANDLE,
+                .allocationSize = memoryBlock.size,
+                .memoryTypeIndex = resources->findMemoryTypeIndex(memoryBlock.memoryTypeBits, memoryBlock.lazy ? 
+                    VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+            };
+            if(vkAllocateMemory(m_device, &memoryAllocateInfo, VK_NULL_HANDLE, &memoryBlock.memory) != VK_SUCCESS)
+                throw std::runtime_error("VK ERROR: Failed to allocate render graph memory.");
+            m_transientMemorySize += memoryBlock.size;
+            if(memoryBlock.lazy)
+                m_lazyMemorySize += memoryBlock.size;
+        }
+
+        for(uint32_t i = 0; i < m_physicalImages.size(); ++i)
+        {
+            PhysicalImage& physicalImage = m_physicalImages[i];
+            if(vkBindImageMemory(m_device, physicalImage.image, m_memoryBlocks[physicalImage.block].memory, 0) != VK_SUCCESS)
+                throw std::runtime_error("VK ERROR: Failed to bind render graph image memory.");
+            VkImageAspectFlags viewAspect = physicalImage.desc.aspect & VK_IMAGE_ASPECT_DEPTH_BIT ? 
+                VK_IMAGE_ASPECT_DEPTH_BIT : physicalImage.desc.aspect;
+            resources->createImageView(physicalImage.imageView, physicalImage.image, physicalImage.desc.format, viewAspect);
+
+            // Until a frame has run, the first image of a block waits for its last image as if it was the previous frame
+            MemoryBlock& memoryBlock = m_memoryBlocks[physicalImage.block];
+            const Pass& lastPass = m_passes[physicalImage.lastPass];
+            bool lastInBlock = std::none_of(m_physicalImages.begin(), m_physicalImages.end(), [&](const PhysicalImage& other)
+            {
+                return other.block == physicalImage.block && other.lastPass > physicalImage.lastPass;
+            });
+            for(const Pass::Use& use: lastPass.m_uses)
+            {
+                if(lastInBlock && use.image == transients[i])
+                {
+                    memoryBlock.lastStages |= use.stages;
+                    memoryBlock.lastWriteAccess |= use.access & writeAccessMask;
+                }
+            }
+        }
+
+        std::cout << "VK INFO: Render graph placed " << m_physicalImages.size() << " transient images in " << 
+            m_transientMemorySize / (1024.f * 1024.f) << " MiB (" << m_lazyMemorySize / (1024.f * 1024.f) << 
+            " MiB of it lazily allocated, " << m_unaliasedMemorySize / (1024.f * 1024.f) << " MiB without aliasing), " << 
+            m_culledPassCount << " passes culled.\n";
+    }
+
+    for(uint32_t i = 0; i < transients.size(); ++i)
+    {
+        Image& image = m_images[transients[i]];
+        image.physicalIndex = i;
+        image.image = m_physicalImages[i].image;
+        image.imageView = m_physicalImages[i].imageView;
+    }
+}
+
+void RenderGraph::releaseTransients()
+{
+    if(m_physicalImages.empty())
+        return;
+
+    // Frames in flight may still render to them
+    Resources::get()->deferDestruction([device = m_device, physicalImages = m_physicalImages, memoryBlocks = m_memoryBlocks]()
+    {
+        for(const PhysicalImage& physicalImage: physicalImages)
+        {
+            vkDestroyImageView(device, physicalImage.imageView, VK_NULL_HANDLE);
+            vkDestroyImage(device, physicalImage.image, VK_NULL_HANDLE);
+        }
+        for(const MemoryBlock& memoryBlock: memoryBlocks)
+            vkFreeMemory(device, memoryBlock.memory, VK_NULL_HANDLE);
+    });
+    m_physicalImages.clear();
+    m_memoryBlocks.clear();
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+    for(uint32_t passIndex = 0; passIndex < m_passes.size(); ++passIndex)
+    {
+        const Pass& pass = m_passes[passIndex];
+        if(pass.m_culled)
+            continue;
+
+        cmdBarriers(commandBuffer, pass, passIndex);
+        bool rendering = !pass.m_colorAttachments.empty() || pass.m_depthAttachment.image != InvalidHandle;
+        if(rendering)
+            cmdBeginRendering(commandBuffer, pass);
+        pass.m_execute(commandBuffer);
+        if(rendering)
+            vkCmdEndRenderingKHR(commandBuffer);
+
+        // Whatever is aliased into the same memory next waits for this image's last accesses
+        for(const Pass::Use& use: pass.m_uses)
+        {
+            const Image& image = m_images[use.image];
+            if(image.imported || image.lastPass != passIndex)
+                continue;
+            MemoryBlock& memoryBlock = m_memoryBlocks[m_physicalImages[image.physicalIndex].block];
+            memoryBlock.lastStages = image.state.writeStages | image.state.readStages;
+            memoryBlock.lastWriteAccess = image.state.writeAccess;
+        }
+    }
+
+    // Leave imported images in the layout their owner expects
+    std::vector<VkImageMemoryBarrier2KHR> imageBarriers;
+    for(const Image& image: m_images)
+    {
+        if(!image.imported || image.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || image.finalLayout == image.state.layout)
+            continue;
+        imageBarriers.push_back(imageBarrier(image.image, image.desc.aspect, image.state.layout, image.finalLayout,
+            image.state.writeStages | image.state.readStages, image.state.writeAccess,
+            VK_PIPELINE_STAGE_2_NONE_KHR, VK_ACCESS_2_NONE_KHR));
+    }
+    cmdPipelineBarriers(commandBuffer, imageBarriers);
+}
+
+void RenderGraph::cmdBarriers(VkCommandBuffer commandBuffer, const Pass& pass, uint32_t passIndex)
+{
+    std::vector<VkImageMemoryBarrier2KHR> imageBarriers;
+    for(const Pass::Use& use: pass.m_uses)
+    {
+        Image& image = m_images[use.image];
+        ImageState& state = image.state;
+
+        // Transient contents never survive the frame, they start over from whatever last used their memory
+        if(!image.imported && image.firstPass == passIndex)
+        {
+            const MemoryBlock& memoryBlock = m_memoryBlocks[m_physicalImages[image.physicalIndex].block];
+            state = {VK_IMAGE_LAYOUT_UNDEFINED, memoryBlock.lastStages, memoryBlock.lastWriteAccess, 
+                VK_PIPELINE_STAGE_2_NONE_KHR, VK_PIPELINE_STAGE_2_NONE_KHR};
+        }
+
+        // Layout changes and writes wait for every earlier access, reads only for a write they don't see yet.
+        // Reads following reads in the same layout need nothing.
+        if(state.layout != use.layout || use.write)
+        {
+            VkPipelineStageFlags2KHR srcStages = state.writeStages | state.readStages;
+            if(state.layout != use.layout || srcStages != VK_PIPELINE_STAGE_2_NONE_KHR)
+                imageBarriers.push_back(imageBarrier(image.image, image.desc.aspect, state.layout, use.layout,
+                    srcStages, state.writeAccess, use.stages, use.access));
+            if(use.write)
+                state = {use.layout, use.stages, use.access & writeAccessMask, VK_PIPELINE_STAGE_2_NONE_KHR, VK_PIPELINE_STAGE_2_NONE_KHR};
+            else
+                state = {use.layout, state.writeStages, state.writeAccess, use.stages, use.stages};
+        }
+        else
+        {
+            if(state.writeAccess != VK_ACCESS_2_NONE_KHR && (use.stages & ~state.visibleStages))
+            {
+                imageBarriers.push_back(imageBarrier(image.image, image.desc.aspect, state.layout, state.layout,
+                    state.writeStages, state.writeAccess, use.stages, use.access));
+                state.visibleStages |= use.stages;
+            }
+            state.readStages |= use.stages;
+        }
+    }
+    cmdPipelineBarriers(commandBuffer, imageBarriers);
+}
+
+void RenderGraph::cmdBeginRendering(VkCommandBuffer commandBuffer, const Pass& pass) const
+{
+    auto attachmentInfo = [this](const Pass::Attachment& attachment, VkImageLayout layout)
+    {
+        bool resolve = attachment.resolveImage != InvalidHandle;
+        VkRenderingAttachmentInfoKHR renderingAttachmentInfo = {
+            .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+            .pNext = VK_NULL_HANDLE,
+            .imageView = m_images[attachment.image].imageView,
+            .imageLayout = layout,
+            .resolveMode = resolve ? VK_RESOLVE_MODE_AVERAGE_BIT : VK_RESOLVE_MODE_NONE,
+            .resolveImageView = resolve ? m_images[attachment.resolveImage].imageView : VK_NULL_HANDLE,
+            .resolveImageLayout = resolve ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+            .loadOp = attachment.loadOp,
+            .storeOp = attachment.storeOp,
+            .clearValue = attachment.clearValue
+        };
+        return renderingAttachmentInfo;
+    };
+
+    std::vector<VkRenderingAttachmentInfoKHR> colorAttachmentInfos;
+    for(const Pass::Attachment& attachment: pass.m_colorAttachments)
+        colorAttachmentInfos.push_back(attachmentInfo(attachment, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+    bool depth = pass.m_depthAttachment.image != InvalidHandle;
+    VkRenderingAttachmentInfoKHR depthAttachmentInfo = {};
+    if(depth)
+        depthAttachmentInfo = attachmentInfo(pass.m_depthAttachment, pass.m_depthWrite ? 
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+
+    // Without an explicit area the pass covers its first attachment
+    VkExtent2D renderArea = pass.m_renderArea;
+    if(renderArea.width == 0 || renderArea.height == 0)
+        renderArea = m_images[pass.m_colorAttachments.empty() ? pass.m_depthAttachment.image : pass.m_colorAttachments[0].image].desc.extent;
+    VkRenderingInfoKHR renderingInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+        .pNext = VK_NULL_HANDLE,
+        .flags = pass.m_renderingFlags,
+        .renderArea = {.offset = {0, 0}, .extent = renderArea},
+        .layerCount = 1,
+        .viewMask = 0,
+        .colorAttachmentCount = static_cast<uint32_t>(colorAttachmentInfos.size()),
+        .pColorAttachments = colorAttachmentInfos.data(),
+        .pDepthAttachment = depth ? &depthAttachmentInfo : VK_NULL_HANDLE,
+        .pStencilAttachment = VK_NULL_HANDLE
+    };
+    vkCmdBeginRenderingKHR(commandBuffer, &renderingInfo);
+}
+
+void RenderGraph::cleanUp()
+{
+    for(const PhysicalImage& physicalImage: m_physicalImages)
+    {
+        vkDestroyImageView(m_device, physicalImage.imageView, VK_NULL_HANDLE);
+        vkDestroyImage(m_device, physicalImage.image, VK_NULL_HANDLE);
+    }
+    for(const MemoryBlock& memoryBlock: m_memoryBlocks)
+        vkFreeMemory(m_device, memoryBlock.memory, VK_NULL_HANDLE);
+    m_physicalImages.clear();
+    m_memoryBlocks.clear();
+}
\ No newline at end of file
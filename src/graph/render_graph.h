@@ -0,0 +1,160 @@
+# pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <functional>
+
+// How a pass touches an image, decides the layout it needs and the stages and accesses barriers wait for
+enum class RenderGraphAccess
+{
+    ColorAttachment,
+    ResolveAttachment,
+    DepthAttachment,
+    DepthAttachmentRead,
+    SampledRead,
+    TransferSrc,
+    TransferDst
+};
+
+struct RenderGraphImageDesc
+{
+    VkFormat format;
+    VkExtent2D extent;
+    VkSampleCountFlagBits sampleCount;
+    VkImageUsageFlags usage;
+    VkImageAspectFlags aspect;
+
+    bool operator==(const RenderGraphImageDesc& other) const;
+};
+
+// A frame's passes are declared anew every time they are recorded. compile() culls the passes nothing depends on and
+// places transient images whose lifetimes don't overlap in the same memory, execute() records the passes with the
+// barriers their reads and writes call for. Physical transient images are kept as long as the declarations match.
+class RenderGraph
+{
+public:
+    using ResourceHandle = uint32_t;
+    static constexpr ResourceHandle InvalidHandle = ~0u;
+
+    class Pass
+    {
+    public:
+        Pass& color(ResourceHandle image, VkAttachmentLoadOp loadOp, VkAttachmentStoreOp storeOp,
+            VkClearColorValue clearValue = {}, ResourceHandle resolveImage = InvalidHandle);
+        Pass& depth(ResourceHandle image, VkAttachmentLoadOp loadOp, VkAttachmentStoreOp storeOp,
+            float clearDepth = 1.f, bool write = true);
+        Pass& read(ResourceHandle image, RenderGraphAccess access);
+        Pass& write(ResourceHandle image, RenderGraphAccess access);
+        Pass& renderArea(VkExtent2D extent) { m_renderArea = extent; return *this; }
+        Pass& renderingFlags(VkRenderingFlagsKHR flags) { m_renderingFlags = flags; return *this; }
+        Pass& sideEffect() { m_sideEffect = true; return *this; }  // Never culled, e.g. reads back to the host
+    private:
+        friend class RenderGraph;
+        struct Attachment
+        {
+            ResourceHandle image;
+            VkAttachmentLoadOp loadOp;
+            VkAttachmentStoreOp storeOp;
+            VkClearValue clearValue;
+            ResourceHandle resolveImage;
+        };
+        struct Use
+        {
+            ResourceHandle image;
+            VkImageLayout layout;
+            VkPipelineStageFlags2KHR stages;
+            VkAccessFlags2KHR access;
+            bool read, write;  // Reads keep the writers alive during culling, writes need exclusive access
+        };
+        void use(ResourceHandle image, RenderGraphAccess access, bool read, bool write);
+
+        RenderGraph* m_graph;
+        std::string m_name;
+        std::function<void(VkCommandBuffer)> m_execute;
+        std::vector<Attachment> m_colorAttachments;
+        Attachment m_depthAttachment = {InvalidHandle};
+        bool m_depthWrite = true;
+        std::vector<Use> m_uses;
+        VkExtent2D m_renderArea = {0, 0};
+        VkRenderingFlagsKHR m_renderingFlags = 0;
+        bool m_sideEffect = false;
+        bool m_culled = false;
+    };
+
+    RenderGraph(VkDevice device);
+    void reset();
+    // Imported images outlive the frame, they are left in finalLayout unless that is VK_IMAGE_LAYOUT_UNDEFINED
+    ResourceHandle importImage(const std::string& name, VkImage image, VkImageView imageView, VkImageAspectFlags aspect, VkExtent2D extent,
+        VkImageLayout initialLayout, VkPipelineStageFlags2KHR initialStage, VkImageLayout finalLayout);
+    ResourceHandle createImage(const std::string& name, const RenderGraphImageDesc& desc);
+    // The reference stays valid until reset(), execute is called with the frame's command buffer
+    Pass& addPass(const std::string& name, std::function<void(VkCommandBuffer)> execute);
+    void compile();
+    void execute(VkCommandBuffer commandBuffer);
+    void cleanUp();
+    // Valid from compile() on, for passes that need the image itself
+    VkImage getImage(ResourceHandle image) const { return m_images[image].image; }
+
+    uint32_t culledPassCount() const { return m_culledPassCount; }
+    VkDeviceSize transientMemorySize() const { return m_transientMemorySize; }
+    VkDeviceSize lazyMemorySize() const { return m_lazyMemorySize; }
+    VkDeviceSize unaliasedMemorySize() const { return m_unaliasedMemorySize; }
+private:
+    // Where the last accesses to an image happened, what the next barrier has to wait for
+    struct ImageState
+    {
+        VkImageLayout layout;
+        VkPipelineStageFlags2KHR writeStages;
+        VkAccessFlags2KHR writeAccess;
+        VkPipelineStageFlags2KHR readStages;
+        VkPipelineStageFlags2KHR visibleStages;  // Reading stages the last write is already visible to
+    };
+    struct Image
+    {
+        std::string name;
+        bool imported;
+        RenderGraphImageDesc desc;
+        VkImage image;
+        VkImageView imageView;
+        VkImageLayout finalLayout;
+        ImageState state;
+        uint32_t firstPass, lastPass;  // Lifetime among the passes that survived culling
+        uint32_t physicalIndex;
+    };
+    struct PhysicalImage
+    {
+        RenderGraphImageDesc desc;
+        uint32_t firstPass, lastPass;
+        VkImage image;
+        VkImageView imageView;
+        VkMemoryRequirements memoryRequirements;
+        bool lazy;  // Attachment only, backed by lazily allocated memory
+        uint32_t block;
+    };
+    struct MemoryBlock
+    {
+        VkDeviceMemory memory;
+        VkDeviceSize size;
+        uint32_t memoryTypeBits;
+        bool lazy;
+        VkPipelineStageFlags2KHR lastStages;  // Stages and writes of the block's last use, this frame or the previous one
+        VkAccessFlags2KHR lastWriteAccess;
+    };
+
+    void cull();
+    void allocateTransients();
+    void releaseTransients();
+    void cmdBarriers(VkCommandBuffer commandBuffer, const Pass& pass, uint32_t passIndex);
+    void cmdBeginRendering(VkCommandBuffer commandBuffer, const Pass& pass) const;
+
+    VkDevice m_device;
+    std::vector<Image> m_images;
+    std::deque<Pass> m_passes;
+    std::vector<PhysicalImage> m_physicalImages;
+    std::vector<MemoryBlock> m_memoryBlocks;
+    uint32_t m_culledPassCount = 0;
+    VkDeviceSize m_transientMemorySize = 0, m_lazyMemorySize = 0, m_unaliasedMemorySize = 0;
+};
\ No newline at end of file
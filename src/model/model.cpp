@@ -22,22 +22,28 @@ void Model::cmdBindBuffers(VkCommandBuffer commandBuffer) const
     vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 }
 
-void Model::cmdDrawIndexed(VkCommandBuffer commandBuffer) const
+void Model::cmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t firstChunk, uint32_t chunkCount) const
 {
-    vkCmdDrawIndexed(commandBuffer, m_indices.size(), 1, 0, 0, 0);
+    uint32_t triangleCount = static_cast<uint32_t>(m_indices.size() / 3);
+    for(uint32_t chunk = firstChunk; chunk < firstChunk + chunkCount; ++chunk)
+    {
+        uint32_t firstTriangle = static_cast<uint64_t>(chunk) * triangleCount / m_drawChunkCount,
+            lastTriangle = static_cast<uint64_t>(chunk + 1) * triangleCount / m_drawChunkCount;
+        if(lastTriangle > firstTriangle)
+            vkCmdDrawIndexed(commandBuffer, 3 * (lastTriangle - firstTriangle), 1, 3 * firstTriangle, 0, 0);
+    }
 }
 
-void Model::cleanUp(VkDevice device)
+void Model::cleanUp()
 {
-    vkDestroyBuffer(device, m_indexBuffer, VK_NULL_HANDLE);
-    vkFreeMemory(device, m_indexBufferMemory, VK_NULL_HANDLE);
-    vkDestroyBuffer(device, m_vertexBuffer, VK_NULL_HANDLE);
-    vkFreeMemory(device, m_vertexBufferMemory, VK_NULL_HANDLE);
-
-    m_appResources->cleanUpTexture(m_texture);
+    // Frames in flight may still draw the model, it's destroyed once they are done
+    m_appResources->retireBuffer(m_indexBuffer, m_indexBufferMemory);
+    m_appResources->retireBuffer(m_vertexBuffer, m_vertexBufferMemory);
+    m_appResources->retireTexture(m_texture);
+    m_appResources->retireBindlessTexture(m_textureIndex);
 }
 
-void Model::loadModel(const char* filename)
+void Model::loadModel(const char* filename, const char* textureFilename)
 {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
@@ -47,6 +53,12 @@ void Model::loadModel(const char* filename)
     if(!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename))
         throw std::runtime_error("TINYOBJLOADER ERROR: Failed to load model from " + std::string(filename) + ".");
 
+    // Reloading swaps in the new buffers and texture, the old ones are retired
+    if(m_vertexBuffer != VK_NULL_HANDLE)
+        cleanUp();
+    m_vertices.clear();
+    m_indices.clear();
+
     std::unordered_map<Vertex, uint32_t> uniqueVertex;
     for(const tinyobj::shape_t& shape: shapes)
     {
@@ -70,15 +82,6 @@ void Model::loadModel(const char* filename)
     m_appResources->createModelVertexBuffer(m_vertices, m_vertexBuffer, m_vertexBufferMemory);
     m_appResources->createModelIndexBuffer(m_indices, m_indexBuffer, m_indexBufferMemory);
 
-    m_appResources->createTexture("./textures/viking_room.png", m_texture);
-}
-
-VkDescriptorImageInfo Model::getTextureDescriptorImageInfo() const
-{
-    VkDescriptorImageInfo descriptorImageInfo = {
-        .sampler = m_texture.sampler,
-        .imageView = m_texture.imageView,
-        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-    };
-    return descriptorImageInfo;
+    m_appResources->createTexture(textureFilename, m_texture);
+    m_textureIndex = m_appResources->registerBindlessTexture(m_texture);
 }
\ No newline at end of file
@@ -14,19 +14,23 @@ class Model
 public:
     Model();
     void cmdBindBuffers(VkCommandBuffer commandBuffer) const;
-    void cmdDrawIndexed(VkCommandBuffer commandBuffer) const;
-    void cleanUp(VkDevice device);
-    void loadModel(const char* filename);
-    VkDescriptorImageInfo getTextureDescriptorImageInfo() const;
+    void cmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t firstChunk, uint32_t chunkCount) const;
+    void setDrawChunkCount(uint32_t chunkCount) { m_drawChunkCount = chunkCount; }
+    uint32_t drawChunkCount() const { return m_drawChunkCount; }
+    void cleanUp();
+    void loadModel(const char* filename, const char* textureFilename);
+    uint32_t textureIndex() const { return m_textureIndex; }
 private:
     // Images
     Texture m_texture;
+    uint32_t m_textureIndex = 0;  // Slot of m_texture in the bindless descriptor set
 
     Resources* m_appResources;
-    VkBuffer m_vertexBuffer;
-    VkBuffer m_indexBuffer;
-    VkDeviceMemory m_vertexBufferMemory;
-    VkDeviceMemory m_indexBufferMemory;
+    VkBuffer m_vertexBuffer = VK_NULL_HANDLE;
+    VkBuffer m_indexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_vertexBufferMemory = VK_NULL_HANDLE;
+    VkDeviceMemory m_indexBufferMemory = VK_NULL_HANDLE;
     std::vector<Vertex> m_vertices;
     std::vector<uint32_t> m_indices;
+    uint32_t m_drawChunkCount = 1;  // The index buffer is drawn in this many draw calls of whole triangles
 };
\ No newline at end of file
@@ -3,14 +3,14 @@
 #include "../resources.h"
 
 #include <random>
-#include <time.h>
 #include <iostream>
+#include <cstddef>
 
-void ParticleGroup::initParticleGroup(uint32_t particleCount)
+void ParticleGroup::initParticleGroup(uint32_t particleCount, uint32_t seed)
 {
     m_resources = Resources::get();
 
-    std::default_random_engine rndEngine((unsigned)time(nullptr));
+    std::mt19937 rndEngine(seed);
     std::uniform_real_distribution<float> dist(0.f, 1.f);
 
     // Fill in particle data
@@ -31,19 +31,105 @@ void ParticleGroup::initParticleGroup(uint32_t particleCount)
         m_particles[i].position = {posX, posY, posZ};
         m_particles[i].velosity = {velX, velY, velZ};
         m_particles[i].color = {dist(rndEngine), dist(rndEngine), dist(rndEngine), 1.f};
+        m_particles[i].prevPosition = m_particles[i].position;
     }
     
     m_resources->createParticleUBOs(m_particleUBOs, m_particleUBOMemories, m_particleUBOMapped);
-    m_resources->createParticleSSBOs(m_particleSSBOs, m_particleSSBOMemories, m_particles);
+    m_resources->createParticleSSBOs(m_particleSSBOs, m_particleSSBOMemories, m_particles, m_resources->maxInflightFrames(), false);
+    m_resources->createParticleSSBOs(m_simulationSSBOs, m_simulationSSBOMemories, m_particles, 2, true);
+    m_latestSimulationSSBO = 0;
+
+    // Fixed per frame index, only the blend factor gets updated while running
+    for(uint32_t i = 0; i < m_resources->maxInflightFrames(); ++i)
+    {
+        UBOParticle uboParticle = {
+            .deltaTime = m_resources->simulationTimeStep(),
+            .particleCount = particleCount,
+            .interpolationAlpha = 0.f
+        };
+        memcpy(m_particleUBOMapped[i], &uboParticle, sizeof(UBOParticle));
+    }
 }
 
-void ParticleGroup::cmdUpdateParticles(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+void ParticleGroup::cmdUpdateParticles(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t substepCount)
 {
-    m_resources->cmdUpdateParticles(commandBuffer, 
-        m_computePipeline, 
-        m_computePipelineLayout, 
-        m_computeDescriptorSets[frameIndex], 
-        static_cast<uint32_t>(m_particles.size()));
+    // The previous submission may still be reading or writing the ping-pong buffers
+    cmdMemoryBarrier(commandBuffer, 
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    for(uint32_t step = 0; step < substepCount; ++step)
+    {
+        // Descriptor set 2 * frameIndex reads simulation buffer 0 and writes 1, 2 * frameIndex + 1 the other way round
+        m_resources->cmdUpdateParticles(commandBuffer, 
+            m_computePipeline, 
+            m_computePipelineLayout, 
+            m_computeDescriptorSets[2 * frameIndex + m_latestSimulationSSBO], 
+            static_cast<uint32_t>(m_particles.size()));
+        m_latestSimulationSSBO ^= 1;
+
+        VkPipelineStageFlags dstStage = step + 1 < substepCount ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkAccessFlags dstAccess = step + 1 < substepCount ? VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_TRANSFER_READ_BIT;
+        cmdMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, dstStage, dstAccess);
+    }
+
+    // Publish the latest state to this frame's SSBO, even if no step was taken, so the frame never draws stale data
+    VkBufferCopy bufferCopy = {
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = particleBufferSize()
+    };
+    vkCmdCopyBuffer(commandBuffer, m_simulationSSBOs[m_latestSimulationSSBO], m_particleSSBOs[frameIndex], 1, &bufferCopy);
+
+    // Release the SSBO to the graphic queue family, cmdAcquireParticles is the matching half
+    if(m_resources->computeQueueFamily() != m_resources->graphicQueueFamily())
+        cmdOwnershipBarrier(commandBuffer, m_particleSSBOs[frameIndex], 
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+}
+
+void ParticleGroup::cmdAcquireParticles(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+    cmdOwnershipBarrier(commandBuffer, m_particleSSBOs[frameIndex], 
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+}
+
+void ParticleGroup::cmdOwnershipBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer,
+    VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+    VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) const
+{
+    VkBufferMemoryBarrier bufferMemoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .pNext = VK_NULL_HANDLE,
+        .srcAccessMask = srcAccess,
+        .dstAccessMask = dstAccess,
+        .srcQueueFamilyIndex = m_resources->computeQueueFamily(),
+        .dstQueueFamilyIndex = m_resources->graphicQueueFamily(),
+        .buffer = buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0,
+        0, VK_NULL_HANDLE,
+        1, &bufferMemoryBarrier,
+        0, VK_NULL_HANDLE);
+}
+
+void ParticleGroup::cmdMemoryBarrier(VkCommandBuffer commandBuffer,
+    VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+    VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) const
+{
+    VkMemoryBarrier memoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = VK_NULL_HANDLE,
+        .srcAccessMask = srcAccess,
+        .dstAccessMask = dstAccess
+    };
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0,
+        1, &memoryBarrier,
+        0, VK_NULL_HANDLE,
+        0, VK_NULL_HANDLE);
 }
 
 void ParticleGroup::cmdDrawParticles(VkCommandBuffer commandBuffer, uint32_t frameIndex)
@@ -66,18 +152,16 @@ void ParticleGroup::allocateDescriptorSet()
     m_resources->allocateParticleDescriptorSets(m_computeDescriptorSets,
         m_graphicDescriptorSets, 
         m_particleUBOs, 
-        m_particleSSBOs, 
+        m_simulationSSBOs, 
         m_graphicDescriptorSetLayout,
         m_computeDescriptorSetLayout);
 }
 
-void ParticleGroup::updateUniformBuffers(uint32_t frameIndex, float deltaTime)
+void ParticleGroup::updateUniformBuffers(uint32_t frameIndex, float interpolationAlpha)
 {
-    UBOParticle uboParticle = {
-        .deltaTime = deltaTime,
-        .particleCount = static_cast<uint32_t>(m_particles.size())
-    };
-    memcpy(m_particleUBOMapped[frameIndex], &uboParticle, sizeof(UBOParticle));
+    // The compute queue may still be reading deltaTime and particleCount of this buffer, leave them alone
+    memcpy(static_cast<char*>(m_particleUBOMapped[frameIndex]) + offsetof(UBOParticle, interpolationAlpha), 
+        &interpolationAlpha, sizeof(float));
 }
 
 void ParticleGroup::cleanUp(VkDevice device, uint32_t maxInFlightFence)
@@ -90,6 +174,11 @@ void ParticleGroup::cleanUp(VkDevice device, uint32_t maxInFlightFence)
         vkDestroyBuffer(device, m_particleSSBOs[i], VK_NULL_HANDLE);
         vkFreeMemory(device, m_particleSSBOMemories[i], VK_NULL_HANDLE);
     }
+    for(uint32_t i = 0; i < m_simulationSSBOs.size(); ++i)
+    {
+        vkDestroyBuffer(device, m_simulationSSBOs[i], VK_NULL_HANDLE);
+        vkFreeMemory(device, m_simulationSSBOMemories[i], VK_NULL_HANDLE);
+    }
     vkDestroyDescriptorSetLayout(device, m_computeDescriptorSetLayout, VK_NULL_HANDLE);
     vkDestroyDescriptorSetLayout(device, m_graphicDescriptorSetLayout, VK_NULL_HANDLE);
     vkDestroyPipelineLayout(device, m_graphicPipelineLayout, VK_NULL_HANDLE);
@@ -98,17 +187,45 @@ void ParticleGroup::cleanUp(VkDevice device, uint32_t maxInFlightFence)
     vkDestroyPipeline(device, m_computePipeline, VK_NULL_HANDLE);
 }
 
-void ParticleGroup::createGraphicPipeline()
+std::function<void()> ParticleGroup::replaceGraphicPipeline(VkPipeline graphicPipeline, VkPipelineLayout graphicPipelineLayout)
 {
-    m_resources->createParticleGraphicPipeline(m_graphicPipeline, m_graphicPipelineLayout, m_graphicDescriptorSetLayout);
+    // Returns the destruction of the replaced pipeline, to be deferred until no frame uses it
+    VkDevice device = m_resources->device();
+    std::function<void()> destroyOld = [device, pipeline = m_graphicPipeline, pipelineLayout = m_graphicPipelineLayout]()
+    {
+        vkDestroyPipeline(device, pipeline, VK_NULL_HANDLE);
+        vkDestroyPipelineLayout(device, pipelineLayout, VK_NULL_HANDLE);
+    };
+    m_graphicPipeline = graphicPipeline;
+    m_graphicPipelineLayout = graphicPipelineLayout;
+    return destroyOld;
 }
 
-void ParticleGroup::createDescriptorSetLayout()
+std::function<void()> ParticleGroup::replaceComputePipeline(VkPipeline computePipeline, VkPipelineLayout computePipelineLayout)
 {
-    m_resources->createParticlesDescriptorSetLayout(m_computeDescriptorSetLayout, m_graphicDescriptorSetLayout);
+    VkDevice device = m_resources->device();
+    std::function<void()> destroyOld = [device, pipeline = m_computePipeline, pipelineLayout = m_computePipelineLayout]()
+    {
+        vkDestroyPipeline(device, pipeline, VK_NULL_HANDLE);
+        vkDestroyPipelineLayout(device, pipelineLayout, VK_NULL_HANDLE);
+    };
+    m_computePipeline = computePipeline;
+    m_computePipelineLayout = computePipelineLayout;
+    return destroyOld;
+}
+
+void ParticleGroup::warmUpGraphicPipeline(VkSampleCountFlagBits sampleCount, VkFormat colorFormat, VkFormat depthFormat) const
+{
+    // Only fills in the pipeline cache
+    VkPipeline graphicPipeline;
+    VkPipelineLayout graphicPipelineLayout;
+    m_resources->createParticleGraphicPipeline(graphicPipeline, graphicPipelineLayout, m_graphicDescriptorSetLayout, 
+        sampleCount, colorFormat, depthFormat);
+    vkDestroyPipeline(m_resources->device(), graphicPipeline, VK_NULL_HANDLE);
+    vkDestroyPipelineLayout(m_resources->device(), graphicPipelineLayout, VK_NULL_HANDLE);
 }
 
-void ParticleGroup::createComputePipeline()
+void ParticleGroup::createDescriptorSetLayout()
 {
-    m_resources->createParticleComputePipeline(m_computePipeline, m_computePipelineLayout, m_computeDescriptorSetLayout);
+    m_resources->createParticlesDescriptorSetLayout(m_computeDescriptorSetLayout, m_graphicDescriptorSetLayout);
 }
\ No newline at end of file
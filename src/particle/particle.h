@@ -2,6 +2,7 @@
 
 #include <glm/glm.hpp>
 #include <vector>
+#include <functional>
 #include <vulkan/vulkan.h>
 
 class Resources;
@@ -11,6 +12,7 @@ struct Particle
     alignas(16) glm::vec3 position;  // algnment: 16B, size: 12B
     glm::vec4 color;  // algnment: 16B, size: 12B
     alignas(16) glm::vec3 velosity;  // algnment: 16B, size: 12B
+    alignas(16) glm::vec3 prevPosition;  // algnment: 16B, size: 12B. Position before the latest simulation step
 };
 
 class ParticleGroup
@@ -20,37 +22,54 @@ public:
     {
         float deltaTime;
         uint32_t particleCount;
+        float interpolationAlpha;  // Blend factor between prevPosition and position when drawing
     };
     ParticleGroup();
     void allocateDescriptorSet();
     void createDescriptorSetLayout();
-    void updateUniformBuffers(uint32_t frameIndex, float deltaTime);
-    void createComputePipeline();
-    void createGraphicPipeline();
+    void updateUniformBuffers(uint32_t frameIndex, float interpolationAlpha);
+    void warmUpGraphicPipeline(VkSampleCountFlagBits sampleCount, VkFormat colorFormat, VkFormat depthFormat) const;
     void cmdDrawParticles(VkCommandBuffer commandBuffer, uint32_t frameIndex);
-    void cmdUpdateParticles(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+    void cmdUpdateParticles(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t substepCount);
+    void cmdAcquireParticles(VkCommandBuffer commandBuffer, uint32_t frameIndex);
     void cleanUp(VkDevice device, uint32_t maxInFlightFence);
-    void initParticleGroup(uint32_t particleCount);
+    std::function<void()> replaceGraphicPipeline(VkPipeline graphicPipeline, VkPipelineLayout graphicPipelineLayout);
+    std::function<void()> replaceComputePipeline(VkPipeline computePipeline, VkPipelineLayout computePipelineLayout);
+    void initParticleGroup(uint32_t particleCount, uint32_t seed);
 
     uint32_t particleBufferSize() const { return m_particles.size() * sizeof(Particle); }
-    uint32_t uniformDescriptorCount() const { return 2; }
-    uint32_t combinedImageSamplerCount() const { return 0; }
-    uint32_t storageDescriptorCount() const { return 2; }
+    VkDescriptorSetLayout graphicDescriptorSetLayout() const { return m_graphicDescriptorSetLayout; }
+    VkDescriptorSetLayout computeDescriptorSetLayout() const { return m_computeDescriptorSetLayout; }
 private:
+    void cmdMemoryBarrier(VkCommandBuffer commandBuffer,
+        VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+        VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) const;
+    void cmdOwnershipBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer,
+        VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+        VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) const;
+
     std::vector<Particle> m_particles;
     std::vector<VkBuffer> m_particleUBOs;
     std::vector<VkDeviceMemory> m_particleUBOMemories;
     std::vector<VkBuffer> m_particleSSBOs;
     std::vector<VkDeviceMemory> m_particleSSBOMemories;
+    // Ping-pong buffers the compute shader steps the simulation in. The per-frame SSBOs above only receive
+    // a copy of the latest state, so stepping never writes a buffer that an in-flight frame is drawing from.
+    // The ping-pong buffers belong to the compute queue family, the per-frame SSBOs are handed over to the graphic 
+    // queue family after each copy.
+    std::vector<VkBuffer> m_simulationSSBOs;
+    std::vector<VkDeviceMemory> m_simulationSSBOMemories;
+    uint32_t m_latestSimulationSSBO = 0;
     std::vector<void*> m_particleUBOMapped;
     std::vector<VkDescriptorSet> m_computeDescriptorSets,
         m_graphicDescriptorSets;
     VkBuffer particleVertexBuffer;
     VkDeviceMemory particleVertexBufferMemory;
-    VkPipeline m_graphicPipeline,
-        m_computePipeline;
-    VkPipelineLayout m_graphicPipelineLayout,
-        m_computePipelineLayout;
+    // Only ever written by the main thread, pipelines compiled in the background are swapped in through replace*Pipeline
+    VkPipeline m_graphicPipeline = VK_NULL_HANDLE,
+        m_computePipeline = VK_NULL_HANDLE;
+    VkPipelineLayout m_graphicPipelineLayout = VK_NULL_HANDLE,
+        m_computePipelineLayout = VK_NULL_HANDLE;
     VkDescriptorSetLayout m_computeDescriptorSetLayout,
         m_graphicDescriptorSetLayout;
 
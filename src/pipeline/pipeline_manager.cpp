@@ -0,0 +1,175 @@
+#include "pipeline_manager.h"
+#include "../thread/thread_pool.h"
+
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <thread>
+
+PipelineManager::PipelineManager(VkDevice device, BuildFunction build, WarmUpFunction warmUp, std::string manifestPath)
+    : m_device(device), m_build(std::move(build)), m_warmUp(std::move(warmUp)), m_manifestPath(std::move(manifestPath))
+{
+    // Leaves a core to the main thread, which goes on loading assets and drawing meanwhile
+    m_threadPool = new ThreadPool(std::min(4u, std::max(2u, std::thread::hardware_concurrency())) - 1);
+    readManifest();
+}
+
+void PipelineManager::buildSet(const std::vector<ShaderPipeline>& pipelines, const PipelineKey& key)
+{
+    // A set still being collected is superseded, its pipelines were never handed out
+    for(const PipelineSwap& pipelineSwap: m_set)
+        destroy(pipelineSwap);
+    m_set.clear();
+    uint64_t generation = ++m_generation;
+    m_setKey = key;
+    m_setSize = static_cast<uint32_t>(pipelines.size());
+    m_setStart = std::chrono::steady_clock::now();
+    if(std::find(m_keys.begin(), m_keys.end(), key) == m_keys.end())
+        m_keys.push_back(key);
+    for(ShaderPipeline pipeline: pipelines)
+        enqueueSetJob(pipeline, key, generation);
+
+    // Nothing draws with warmed up variants, a failure is only logged and never reaches ThreadPool::wait() of a replay
+    for(const PipelineKey& manifestKey: m_manifestKeys)
+        if(!(manifestKey == key))
+            m_threadPool->enqueue([this, manifestKey, key](uint32_t)
+            {
+                try
+                {
+                    m_warmUp(manifestKey, key);
+                }
+                catch(const std::runtime_error& error)
+                {
+                    std::cout << "VK INFO: Pipeline warm-up skipped, " << error.what() << "\n";
+                }
+            });
+    m_manifestKeys.clear();
+}
+
+void PipelineManager::enqueueSetJob(ShaderPipeline pipeline, const PipelineKey& key, uint64_t generation)
+{
+    m_threadPool->enqueue([this, pipeline, key, generation](uint32_t)
+    {
+        try
+        {
+            PipelineSwap pipelineSwap = m_build(pipeline, key);
+            pipelineSwap.generation = generation;
+            std::lock_guard<std::mutex> lock(m_swapMutex);
+            m_swaps.push_back(pipelineSwap);
+        }
+        catch(...)
+        {
+            std::lock_guard<std::mutex> lock(m_exceptionMutex);
+            if(!m_exception)
+                m_exception = std::current_exception();
+        }
+    });
+}
+
+void PipelineManager::rebuild(ShaderPipeline pipeline, const PipelineKey& key)
+{
+    PipelineSwap pipelineSwap;
+    try
+    {
+        pipelineSwap = m_build(pipeline, key);
+    }
+    catch(const std::runtime_error& error)
+    {
+        std::cout << "VK INFO: Failed to rebuild a pipeline, keeping the current one. " << error.what() << "\n";
+        return;
+    }
+    pipelineSwap.generation = 0;
+    std::lock_guard<std::mutex> lock(m_swapMutex);
+    m_swaps.push_back(pipelineSwap);
+}
+
+void PipelineManager::enqueue(std::function<void()> job)
+{
+    m_threadPool->enqueue([job = std::move(job)](uint32_t)
+    {
+        job();
+    });
+}
+
+bool PipelineManager::collect(bool waitForSet, std::vector<PipelineSwap>& set, std::vector<PipelineSwap>& rebuilds)
+{
+    if(waitForSet && m_setSize != 0)
+        m_threadPool->wait();
+    {
+        std::lock_guard<std::mutex> lock(m_exceptionMutex);
+        if(m_exception)
+            std::rethrow_exception(m_exception);
+    }
+    std::vector<PipelineSwap> pipelineSwaps;
+    {
+        std::lock_guard<std::mutex> lock(m_swapMutex);
+        pipelineSwaps.swap(m_swaps);
+    }
+
+    for(const PipelineSwap& pipelineSwap: pipelineSwaps)
+    {
+        if(pipelineSwap.generation == 0)
+            rebuilds.push_back(pipelineSwap);
+        else if(pipelineSwap.generation == m_generation)
+            m_set.push_back(pipelineSwap);
+        else
+            destroy(pipelineSwap);  // Superseded by a later buildSet(), never handed out
+    }
+    if(m_setSize == 0 || m_set.size() != m_setSize)
+        return false;
+    set.insert(set.end(), m_set.begin(), m_set.end());
+    m_set.clear();
+    m_setSize = 0;
+    return true;
+}
+
+void PipelineManager::destroy(const PipelineSwap& pipelineSwap) const
+{
+    vkDestroyPipeline(m_device, pipelineSwap.handle, VK_NULL_HANDLE);
+    vkDestroyPipelineLayout(m_device, pipelineSwap.layout, VK_NULL_HANDLE);
+}
+
+void PipelineManager::cleanUp()
+{
+    // Let pending compilations finish before anything they use goes away
+    delete m_threadPool;
+    m_threadPool = nullptr;
+    for(const PipelineSwap& pipelineSwap: m_swaps)
+        destroy(pipelineSwap);
+    for(const PipelineSwap& pipelineSwap: m_set)
+        destroy(pipelineSwap);
+    m_swaps.clear();
+    m_set.clear();
+    writeManifest();
+}
+
+double PipelineManager::setCompileTime() const
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_setStart).count();
+}
+
+void PipelineManager::readManifest()
+{
+    // One pipeline key per line: sample count, color format, depth format
+    std::ifstream ifs(m_manifestPath);
+    uint32_t sampleCount, colorFormat, depthFormat;
+    while(ifs >> sampleCount >> colorFormat >> depthFormat)
+        m_manifestKeys.push_back({static_cast<VkSampleCountFlagBits>(sampleCount), 
+            static_cast<VkFormat>(colorFormat), static_cast<VkFormat>(depthFormat)});
+    if(!m_manifestKeys.empty())
+        std::cout << "VK INFO: Warming up " << m_manifestKeys.size() << " pipeline variants from " << m_manifestPath << ".\n";
+}
+
+void PipelineManager::writeManifest() const
+{
+    // Called during teardown, a manifest that can't be written only costs the next launch its warm-up
+    std::ofstream ofs(m_manifestPath);
+    if(!ofs.is_open())
+    {
+        std::cout << "VK INFO: Failed to write pipeline manifest to " << m_manifestPath << ".\n";
+        return;
+    }
+    for(const PipelineKey& key: m_keys)
+        ofs << key.sampleCount << " " << key.colorFormat << " " << key.depthFormat << "\n";
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+# pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <mutex>
+#include <exception>
+#include <chrono>
+
+class ThreadPool;
+
+// Render target state a graphic pipeline is compiled against, recorded in the pipeline manifest
+struct PipelineKey
+{
+    VkSampleCountFlagBits sampleCount;
+    VkFormat colorFormat;
+    VkFormat depthFormat;
+    bool operator==(const PipelineKey& other) const 
+    { 
+        return sampleCount == other.sampleCount && colorFormat == other.colorFormat && depthFormat == other.depthFormat; 
+    }
+};
+
+// Pipelines the renderer draws with, hot reload maps shader sources to them
+enum class ShaderPipeline
+{
+    Scene,
+    DepthPrepass,
+    ParticleGraphic,
+    ParticleCompute
+};
+
+// A pipeline compiled in the background, swapped in by the main thread at the start of a frame
+struct PipelineSwap
+{
+    ShaderPipeline pipeline;
+    PipelineKey key;  // Render target state it was built for
+    VkPipeline handle;
+    VkPipelineLayout layout;
+    uint64_t generation;  // buildSet() call it belongs to, 0 for a single hot reloaded pipeline
+};
+
+// Compiles pipelines on worker threads. Every buildSet() starts a new generation, collect() hands its pipelines out 
+// together once all of them are done and destroys those of superseded generations unseen. The render target state 
+// of every set goes to a manifest on exit, the next session compiles the variants it does not use in the background 
+// so they are already in the pipeline cache when needed.
+class PipelineManager
+{
+public:
+    // Builds one pipeline, called by several workers at once
+    using BuildFunction = std::function<PipelineSwap(ShaderPipeline pipeline, const PipelineKey& key)>;
+    // Compiles a manifest variant into the pipeline cache and throws it away, currentKey is the set being built
+    using WarmUpFunction = std::function<void(const PipelineKey& key, const PipelineKey& currentKey)>;
+
+    PipelineManager(VkDevice device, BuildFunction build, WarmUpFunction warmUp, std::string manifestPath);
+    void buildSet(const std::vector<ShaderPipeline>& pipelines, const PipelineKey& key);
+    // Builds a single pipeline on the calling worker, a failure keeps the current one
+    void rebuild(ShaderPipeline pipeline, const PipelineKey& key);
+    void enqueue(std::function<void()> job);
+    // Returns true with the set in set once it is complete, rethrows the first failure of a set job
+    bool collect(bool waitForSet, std::vector<PipelineSwap>& set, std::vector<PipelineSwap>& rebuilds);
+    void destroy(const PipelineSwap& pipelineSwap) const;
+    // Finishes the jobs in flight, destroys what was never handed out and writes the manifest
+    void cleanUp();
+    bool setPending() const { return m_setSize != 0; }
+    const PipelineKey& setKey() const { return m_setKey; }
+    double setCompileTime() const;  // unit: ms, since the last buildSet()
+private:
+    void enqueueSetJob(ShaderPipeline pipeline, const PipelineKey& key, uint64_t generation);
+    void readManifest();
+    void writeManifest() const;
+
+    VkDevice m_device;
+    BuildFunction m_build;
+    WarmUpFunction m_warmUp;
+    ThreadPool* m_threadPool = nullptr;
+
+    std::mutex m_swapMutex;
+    std::vector<PipelineSwap> m_swaps;  // Finished on a worker, not collected yet
+    uint64_t m_generation = 0;  // Bumped by every buildSet(), pipelines of older sets are dropped
+    uint32_t m_setSize = 0;  // Pipelines the set being built is made of, 0 when none is
+    PipelineKey m_setKey = {};  // What the set being built is for
+    std::vector<PipelineSwap> m_set;  // Its pipelines that are done, handed out together once all are
+    std::chrono::steady_clock::time_point m_setStart;
+    std::mutex m_exceptionMutex;
+    std::exception_ptr m_exception;  // First failure of a set job
+
+    std::string m_manifestPath;
+    std::vector<PipelineKey> m_keys;  // Built this session, written to the manifest on exit
+    std::vector<PipelineKey> m_manifestKeys;  // Built by previous sessions, warmed up by the next buildSet()
+};
\ No newline at end of file
@@ -8,18 +8,147 @@
 #include <algorithm>
 #include <fstream>
 #include <chrono>
+#include <cmath>
+#include <ctime>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <filesystem>
+#include <cstdlib>
 
 #include "vulkan_fn.h"
 #include "./model/model.h"
 #include "./model/texture.h"
 #include "./model/mesh.h"
 #include "./particle/particle.h"
+#include "./thread/thread_pool.h"
+#include "./descriptor/descriptor_allocator.h"
+#include "./graph/render_graph.h"
+#include "./texture/texture_loader.h"
+#include "./pipeline/pipeline_manager.h"
+#include "embedded_shaders.h"
 
 Resources::Resources()
 {
 
 }
 
+void Resources::parseCommandLineArguments(int argc, char** argv)
+{
+    // Explicit frame pacing options override the preset, no matter in which order they are given
+    std::optional<uint32_t> framesInFlight, swapChainImageCount;
+    std::optional<std::vector<VkPresentModeKHR>> presentModePreference;
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        auto nextValue = [&]() -> std::string
+        {
+            if(i + 1 >= argc)
+                throw std::runtime_error("ARGS ERROR: Missing value for " + arg + ".");
+            return argv[++i];
+        };
+
+        if(arg == "--deterministic") m_deterministic = true;
+        else if(arg == "--seed") m_randomSeed = static_cast<uint32_t>(std::stoul(nextValue()));
+        else if(arg == "--frames") m_frameLimit = static_cast<uint32_t>(std::stoul(nextValue()));
+        else if(arg == "--headless") m_headless = true;
+        else if(arg == "--capture") m_capturePath = nextValue();
+        else if(arg == "--golden") m_goldenImagePath = nextValue();
+        else if(arg == "--tolerance") m_goldenTolerance = static_cast<uint32_t>(std::stoul(nextValue()));
+        else if(arg == "--preset") applyPreset(nextValue());
+        else if(arg == "--frames-in-flight") framesInFlight = static_cast<uint32_t>(std::stoul(nextValue()));
+        else if(arg == "--swapchain-images") swapChainImageCount = static_cast<uint32_t>(std::stoul(nextValue()));
+        else if(arg == "--present-mode") presentModePreference = parsePresentModes(nextValue());
+        else if(arg == "--record-threads") m_recordThreadCount = static_cast<uint32_t>(std::stoul(nextValue()));
+        else if(arg == "--cache-commands") m_cacheDrawCommands = true;
+        else if(arg == "--glslc") m_glslcPath = nextValue();
+        else if(arg == "--draw-chunks") m_drawChunkCount = std::max(1u, static_cast<uint32_t>(std::stoul(nextValue())));
+        else if(arg == "--objects") m_objectCount = std::max(1u, static_cast<uint32_t>(std::stoul(nextValue())));
+        else if(arg == "--per-draw-data")
+        {
+            std::string perDrawData = nextValue();
+            if(perDrawData != "ubo" && perDrawData != "push")
+                throw std::runtime_error("ARGS ERROR: --per-draw-data must be ubo or push.");
+            m_perDrawPushConstants = perDrawData == "push";
+        }
+        else if(arg == "--dynamic-resolution") m_targetFrameTime = std::max(0.f, std::stof(nextValue()));
+        else if(arg == "--msaa")
+        {
+            m_requestedSampleCount = static_cast<uint32_t>(std::stoul(nextValue()));
+            if(m_requestedSampleCount != 1 && m_requestedSampleCount != 2 && m_requestedSampleCount != 4 && m_requestedSampleCount != 8)
+                throw std::runtime_error("ARGS ERROR: --msaa must be 1, 2, 4 or 8.");
+        }
+        else if(arg == "--depth-prepass") m_depthPrepass = true;
+        else if(arg == "--overdraw") m_overdrawView = true;
+        else if(arg == "--rgba8-textures") m_compressedTextures = false;
+        else if(arg == "--texture-threads") m_textureThreadCount = static_cast<uint32_t>(std::stoul(nextValue()));
+        else if(arg == "--texture-load-test") m_textureLoadTestCount = static_cast<uint32_t>(std::stoul(nextValue()));
+        else if(arg == "--msaa-sweep") m_MSAASweepFrames = static_cast<uint32_t>(std::stoul(nextValue()));
+        else if(arg == "--min-sample-shading")
+        {
+            // Scene rate, optionally followed by the particle rate: "0.5" or "1,0"
+            std::string rates = nextValue();
+            size_t comma = rates.find(',');
+            m_sceneMinSampleShading = std::stof(rates.substr(0, comma));
+            m_particleMinSampleShading = comma == std::string::npos ? m_sceneMinSampleShading : std::stof(rates.substr(comma + 1));
+            if(m_sceneMinSampleShading < 0.f || m_sceneMinSampleShading > 1.f || m_particleMinSampleShading < 0.f || m_particleMinSampleShading > 1.f)
+                throw std::runtime_error("ARGS ERROR: --min-sample-shading rates must be between 0 and 1.");
+        }
+        else throw std::runtime_error("ARGS ERROR: Unknown argument " + arg + ".");
+    }
+    if(framesInFlight.has_value())
+    {
+        if(framesInFlight.value() < 1 || framesInFlight.value() > 4)
+            throw std::runtime_error("ARGS ERROR: --frames-in-flight must be between 1 and 4.");
+        m_maxInflightFrames = framesInFlight.value();
+    }
+    if(swapChainImageCount.has_value())
+        m_swapChainImageCount = swapChainImageCount.value();
+    if(m_glslcPath.empty())
+    {
+        const char* vulkanSDK = std::getenv("VULKAN_SDK");
+        m_glslcPath = vulkanSDK != nullptr ? std::string(vulkanSDK) + "/bin/glslc" : "glslc";
+    }
+    if(presentModePreference.has_value())
+        m_presentModePreference = presentModePreference.value();
+    // A sweep climbs from 1x unless told where to start
+    if(m_MSAASweepFrames != 0 && m_requestedSampleCount == 0)
+        m_requestedSampleCount = 1;
+
+    if((!m_capturePath.empty() || !m_goldenImagePath.empty()) && m_frameLimit == 0)
+        throw std::runtime_error("ARGS ERROR: --capture and --golden need --frames to know which frame to read back.");
+    // Pushed transforms are baked into the command buffer, a cached one would keep drawing the first frame's
+    if(m_perDrawPushConstants && m_cacheDrawCommands)
+        throw std::runtime_error("ARGS ERROR: --per-draw-data push can't be combined with --cache-commands.");
+}
+
+void Resources::applyPreset(const std::string& presetName)
+{
+    if(presetName == "low-latency")
+    {
+        // Nothing queued up behind the frame on screen, input is sampled as late as possible
+        m_maxInflightFrames = 1;
+        m_swapChainImageCount = 2;
+        m_presentModePreference = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR};
+    }
+    else if(presetName == "throughput")
+    {
+        // CPU and GPU never wait on each other, at the cost of latency
+        m_maxInflightFrames = 3;
+        m_swapChainImageCount = 4;
+        m_presentModePreference = {VK_PRESENT_MODE_FIFO_KHR};
+    }
+    else if(presetName == "benchmark")
+    {
+        // Unthrottled, frames are presented as soon as they are done and may tear
+        m_maxInflightFrames = 3;
+        m_swapChainImageCount = 3;
+        m_presentModePreference = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR};
+    }
+    else throw std::runtime_error("ARGS ERROR: Unknown preset " + presetName + ", expected low-latency, throughput or benchmark.");
+    m_presetName = presetName;
+}
+
 void Resources::distributeResources()
 {
     m_model = new Model();
@@ -30,7 +159,8 @@ void Resources::initWindow()
 {
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+    glfwWindowHint(GLFW_RESIZABLE, m_deterministic ? GLFW_FALSE : GLFW_TRUE);  // Replays must render at a fixed size
+    glfwWindowHint(GLFW_VISIBLE, m_headless ? GLFW_FALSE : GLFW_TRUE);
 
     m_window = glfwCreateWindow(m_windowWidth, m_windowHeight, "Vulkan Renderer", VK_NULL_HANDLE, VK_NULL_HANDLE);
     if(!glfwVulkanSupported())
@@ -38,9 +168,10 @@ void Resources::initWindow()
     glfwSetWindowUserPointer(m_window, this);
     glfwSetFramebufferSizeCallback(m_window, framebufferResizeCallback);
     glfwSetMouseButtonCallback(m_window, mouseButtonCallback);
+    glfwSetKeyCallback(m_window, keyCallback);
 }
 
-void Resources::recordComputeCommandBuffer(VkCommandBuffer commandBuffer)
+void Resources::recordComputeCommandBuffer(VkCommandBuffer commandBuffer, uint32_t frameIndex)
 {
     VkCommandBufferBeginInfo beginInfo = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -51,9 +182,22 @@ void Resources::recordComputeCommandBuffer(VkCommandBuffer commandBuffer)
     if(vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
         throw std::runtime_error("VK ERROR: Failed to begin recording compute command buffer.");
 
-    // Record update particles commandBuffer
-    if(m_mouseLeftButtonDown)
-        m_particles->cmdUpdateParticles(commandBuffer, m_currentFrameIndex);
+    if(m_timestampQueryPool != VK_NULL_HANDLE)
+    {
+        vkCmdResetQueryPool(commandBuffer, m_timestampQueryPool, 4 * frameIndex, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampQueryPool, 4 * frameIndex);
+    }
+
+    // Record update particles commandBuffer.While the mouse is up no step is taken, the latest state is still copied
+    // to this frame's SSBO so the per-frame SSBOs never drift apart.
+    if(m_pipelinesReady)
+    {
+        m_particles->cmdUpdateParticles(commandBuffer, frameIndex, m_simulationSubstepCount);
+        m_particleAcquirePending[frameIndex] = m_graphicQueueFamily != m_computeQueueFamily;
+    }
+
+    if(m_timestampQueryPool != VK_NULL_HANDLE)
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampQueryPool, 4 * frameIndex + 1);
 
     if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
         throw std::runtime_error("VK ERROR:Failed to end recording compute command buffer.");
@@ -61,41 +205,42 @@ void Resources::recordComputeCommandBuffer(VkCommandBuffer commandBuffer)
 
 void Resources::drawFrame()
 {
-    // Wait for inFlightFence to be signaled.So that we won't record the command buffer in the next frame 
-    // while the GPU is still using the command buffer in current frame(which is to be recorded and used as the next frame).
-    vkWaitForFences(m_device, 1, &m_graphicInFlightFences[m_currentFrameIndex], VK_TRUE, UINT64_MAX);
-    vkWaitForFences(m_device, 1, &m_computeInFlightFences[m_currentFrameIndex], VK_TRUE, UINT64_MAX);
-
-    // Reset fence to unsignaled
-    vkResetFences(m_device, 1, &m_graphicInFlightFences[m_currentFrameIndex]);
-    vkResetFences(m_device, 1, &m_computeInFlightFences[m_currentFrameIndex]);
-
-    // Reset commandbuffer
-    vkResetCommandBuffer(m_graphicCommandBuffers[m_currentFrameIndex], 0);
-    vkResetCommandBuffer(m_computeCommandBuffers[m_currentFrameIndex], 0);
-
-    //// Record and submit compute command buffer
-    recordComputeCommandBuffer(m_computeCommandBuffers[m_currentFrameIndex]);
-    VkSubmitInfo computeSubmitInfo = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext = VK_NULL_HANDLE,
-        .waitSemaphoreCount = 0,
-        .pWaitSemaphores = VK_NULL_HANDLE,
-        .pWaitDstStageMask = VK_NULL_HANDLE,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &m_computeCommandBuffers[m_currentFrameIndex],
-        .signalSemaphoreCount = 1,
-        .pSignalSemaphores = &m_computeCompleteSemaphores[m_currentFrameIndex]
-    };
-    if(vkQueueSubmit(m_graphicComputeQueue, 1, &computeSubmitInfo, m_computeInFlightFences[m_currentFrameIndex]) != VK_SUCCESS)
-        throw std::runtime_error("VK ERROR: Failed to submit compute commandBuffer to grahicAndCompute queue.");
+    // Frame N draws the particle SSBO of m_currentFrameIndex, which the compute queue filled in during frame N - 1.
+    // Meanwhile the simulation of frame N + 1 is stepped into the SSBO of the next frame index.
+    // Graphic work of frame N signals m_graphicTimeline with N, the simulation for frame N signals m_computeTimeline with N.
+    uint64_t frameSerial = m_frameSerial + 1;
+    uint32_t nextFrameIndex = (m_currentFrameIndex + 1) % m_maxInflightFrames;
+
+    // Wait for the graphic and compute submissions of m_maxInflightFrames frames ago, they are the last users of the
+    // command buffers we are going to record. Work of the latest frames keeps running on both queues.
+    if(frameSerial > m_maxInflightFrames)
+    {
+        VkSemaphore waitSemaphores[2] = {m_graphicTimeline, m_computeTimeline};
+        uint64_t waitValues[2] = {frameSerial - m_maxInflightFrames, frameSerial - m_maxInflightFrames + 1};
+        VkSemaphoreWaitInfo waitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .pNext = VK_NULL_HANDLE,
+            .flags = 0,
+            .semaphoreCount = 2,
+            .pSemaphores = waitSemaphores,
+            .pValues = waitValues
+        };
+        if(vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+            throw std::runtime_error("VK ERROR: Failed to wait for timeline semaphores.");
+    }
+    collectTimestamps();
+    collectInputLatency();
+    runDeferredDestructions(completedFrameSerial());
+    applyPipelineSwaps();
+    schedulePipelineCacheFlush();
 
     //// Record and submit graphic command buffer
     // Acquire an image for swapchain
     uint32_t imageIndex;
     VkResult acquireImageResult = vkAcquireNextImageKHR(m_device, m_vkSwapChain, UINT64_MAX, m_acquireImageSemaphores[m_currentFrameIndex], VK_NULL_HANDLE, &imageIndex);
-    if(acquireImageResult == VK_ERROR_OUT_OF_DATE_KHR ||
-        acquireImageResult == VK_SUBOPTIMAL_KHR)
+    // A suboptimal image is still acquired and its semaphore signaled, it gets presented and the swapchain is
+    // recreated afterwards
+    if(acquireImageResult == VK_ERROR_OUT_OF_DATE_KHR)
     {
         /* 
         It's important to know that if vkAcquireNextImageKHR doesn't return VK_SUCCESS,
@@ -106,28 +251,121 @@ void Resources::drawFrame()
         Since the image acquired from the swapchain is not compatible with the window surface, do not present 
         the image, just return drawFrame function.
 
-        drawFrame function returns with m_inFlightFences[m_currentFrame] signaled, avoiding deadlock from 
-        vkWaitForFences.
+        Nothing has been submitted, so the next call simply retries the same frame serial.
         */
         return;  
     }
-    else if(acquireImageResult != VK_SUCCESS)
+    else if(acquireImageResult != VK_SUCCESS && acquireImageResult != VK_SUBOPTIMAL_KHR)
         throw std::runtime_error("VK ERROR: Failed to acquire an image for the swap chain.");
-    recordDrawCommandBuffer(m_graphicCommandBuffers[m_currentFrameIndex], imageIndex);
-    VkSemaphore pWaitSemaphores[2] = {m_computeCompleteSemaphores[m_currentFrameIndex], m_acquireImageSemaphores[m_currentFrameIndex]};
-    VkPipelineStageFlags pWaitStageMask[2] = {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+
+    // Timeline values only cover our own submissions, not presentation. Once the presentation engine hands out an image 
+    // of the new swapchain it has let go of the retired ones, they go as soon as this frame, which waits for the 
+    // acquire, and every frame before it that rendered to them are done.
+    for(std::function<void()>& destroy: m_retiredSwapChains)
+        deferDestruction(std::move(destroy));
+    m_retiredSwapChains.clear();
+
+    // Buffers of this frame index are no longer in use, advance the simulation clock and fill them in
+    updateUniformBuffers();
+
+    // The last frame of a replay also reads back the image, it is recorded on its own
+    auto recordBegin = std::chrono::steady_clock::now();
+    VkCommandBuffer graphicCommandBuffers[2];
+    uint32_t graphicCommandBufferCount = 0;
+    if(!m_cacheDrawCommands || (m_frameLimit != 0 && m_frameCount + 1 == m_frameLimit))
+    {
+        vkResetCommandBuffer(m_graphicCommandBuffers[m_currentFrameIndex], 0);
+        recordDrawCommandBuffer(m_graphicCommandBuffers[m_currentFrameIndex], imageIndex);
+        graphicCommandBuffers[graphicCommandBufferCount++] = m_graphicCommandBuffers[m_currentFrameIndex];
+    }
+    else
+    {
+        // The queue family ownership acquire depends on what the compute queue released, keep it out of the cached buffer
+        if(m_particleAcquirePending[m_currentFrameIndex])
+        {
+            vkResetCommandBuffer(m_graphicCommandBuffers[m_currentFrameIndex], 0);
+            recordParticleAcquire(m_graphicCommandBuffers[m_currentFrameIndex]);
+            graphicCommandBuffers[graphicCommandBufferCount++] = m_graphicCommandBuffers[m_currentFrameIndex];
+        }
+        bool needsRecording;
+        VkCommandBuffer drawCommandBuffer = cachedDrawCommandBuffer(imageIndex, needsRecording);
+        if(needsRecording)
+        {
+            recordDrawCommandBuffer(drawCommandBuffer, imageIndex);
+            ++m_drawCommandRecordCount;
+        }
+        graphicCommandBuffers[graphicCommandBufferCount++] = drawCommandBuffer;
+    }
+    m_recordTimeTotal += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordBegin).count();
+    ++m_recordSampleCount;
+    if(m_pipelinesReady)
+    {
+        // Throughput is measured from the first frame that draws the scene to the latest one
+        m_drawBenchmarkEnd = std::chrono::steady_clock::now();
+        if(m_drawBenchmarkFrameCount++ == 0)
+            m_drawBenchmarkBegin = m_drawBenchmarkEnd;
+    }
+    // Swapchain acquire and present only work with binary semaphores
+    VkSemaphore pWaitSemaphores[2] = {m_computeTimeline, m_acquireImageSemaphores[m_currentFrameIndex]};
+    uint64_t pWaitValues[2] = {frameSerial, 0};
+    VkPipelineStageFlags pWaitStageMask[2] = {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};  // particles are fetched as vertices
+    VkSemaphore pSignalSemaphores[2] = {m_graphicTimeline, m_drawSemaphores[m_currentFrameIndex]};
+    uint64_t pSignalValues[2] = {frameSerial, 0};
+    VkTimelineSemaphoreSubmitInfo graphicTimelineSubmitInfo = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .waitSemaphoreValueCount = 2,
+        .pWaitSemaphoreValues = pWaitValues,
+        .signalSemaphoreValueCount = 2,
+        .pSignalSemaphoreValues = pSignalValues
+    };
     VkSubmitInfo graphicSubmitInfo = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &graphicTimelineSubmitInfo,
         .waitSemaphoreCount = 2,
         .pWaitSemaphores = pWaitSemaphores,
         .pWaitDstStageMask = pWaitStageMask,
+        .commandBufferCount = graphicCommandBufferCount,
+        .pCommandBuffers = graphicCommandBuffers,
+        .signalSemaphoreCount = 2,
+        .pSignalSemaphores = pSignalSemaphores
+    };
+    if(vkQueueSubmit(m_graphicQueue, 1, &graphicSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to submit draw commandBuffer to graphic queue.");
+
+    //// Record and submit compute command buffer for the next frame
+    vkResetCommandBuffer(m_computeCommandBuffers[nextFrameIndex], 0);
+    recordComputeCommandBuffer(m_computeCommandBuffers[nextFrameIndex], nextFrameIndex);
+    // Only the final copy into the particle SSBO has to wait for the graphic frame that last drew from it, 
+    // the simulation steps work on their own buffers and start right away
+    uint64_t computeWaitValue = frameSerial + 1 > m_maxInflightFrames ? frameSerial + 1 - m_maxInflightFrames : 0;
+    uint64_t computeSignalValue = frameSerial + 1;
+    VkPipelineStageFlags computeWaitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkTimelineSemaphoreSubmitInfo computeTimelineSubmitInfo = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .waitSemaphoreValueCount = 1,
+        .pWaitSemaphoreValues = &computeWaitValue,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &computeSignalValue
+    };
+    VkSubmitInfo computeSubmitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &computeTimelineSubmitInfo,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &m_graphicTimeline,
+        .pWaitDstStageMask = &computeWaitStageMask,
         .commandBufferCount = 1,
-        .pCommandBuffers = &m_graphicCommandBuffers[m_currentFrameIndex],
+        .pCommandBuffers = &m_computeCommandBuffers[nextFrameIndex],
         .signalSemaphoreCount = 1,
-        .pSignalSemaphores = &m_drawSemaphores[m_currentFrameIndex]
+        .pSignalSemaphores = &m_computeTimeline
     };
-    if(vkQueueSubmit(m_graphicQueue, 1, &graphicSubmitInfo, m_graphicInFlightFences[m_currentFrameIndex]) != VK_SUCCESS)
-        throw std::runtime_error("VK ERROR: Failed to submit draw commandBuffer to graphic queue.");
+    if(vkQueueSubmit(m_computeQueue, 1, &computeSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to submit compute commandBuffer to compute queue.");
+    m_timestampsWritten[m_currentFrameIndex] = m_timestampQueryPool != VK_NULL_HANDLE;
+    m_timestampSampleCounts[m_currentFrameIndex] = m_MSAASampleCount;
+    m_pendingInputSamples.push_back({frameSerial, m_inputSampleTime});
+    m_frameSerial = frameSerial;
 
     // Present scene image to screen
     VkPresentInfoKHR presentInfo = {
@@ -140,16 +378,20 @@ void Resources::drawFrame()
         .pResults = VK_NULL_HANDLE
         };
     VkResult queuePresentResult = vkQueuePresentKHR(m_vkPresentQueue, &presentInfo);
-    if(queuePresentResult == VK_ERROR_OUT_OF_DATE_KHR || 
-        queuePresentResult == VK_SUBOPTIMAL_KHR || m_framebufferResized)
+    if(queuePresentResult == VK_ERROR_OUT_OF_DATE_KHR || acquireImageResult == VK_SUBOPTIMAL_KHR ||
+        queuePresentResult == VK_SUBOPTIMAL_KHR || m_framebufferResized || m_presentModeChanged)
     {
         m_framebufferResized = false;
         recreateSwapChain();
+        if(m_presentModeChanged)
+            std::cout << "VK INFO: Present mode switched to " << presentModeName(m_presentMode) << ".\n";
+        m_presentModeChanged = false;
     }
     else if(queuePresentResult != VK_SUCCESS)
         throw std::runtime_error("VK ERROR: Failed to present an image to screen.");
 
-    updateUniformBuffers();
+    ++m_frameCount;
+
     m_currentFrameIndex = (m_currentFrameIndex + 1) % m_maxInflightFrames;
 }
 
@@ -157,12 +399,12 @@ void Resources::createInstance()
 {
     // VkApplicationInfo
     VkApplicationInfo appInfo = {};
-    appInfo.sType == VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
     appInfo.pApplicationName = "Vulkan Application";
     appInfo.applicationVersion = VK_MAKE_API_VERSION(0, 1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_API_VERSION(0, 1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_2;  // Timeline semaphores
 
     // VkInstanceCreateInfo
     VkInstanceCreateInfo instanceCreateInfo = {};
@@ -246,7 +488,7 @@ void Resources::pickPhysicalDevice()
             << score_devices.rbegin()->first <<  ".\n";
         
         // Select MASS sample count
-        m_MSAASampleCount = getMSAASampleCount();
+        m_MSAASampleCount = chooseMSAASampleCount(m_requestedSampleCount);
     }
     else throw std::runtime_error("VK ERROR: No suitable physical device for current application.");
 }
@@ -271,10 +513,30 @@ void Resources::createLogicalDevices()
     VkPhysicalDeviceFeatures physicalDeviceFeatures = {};
     physicalDeviceFeatures.samplerAnisotropy = m_physicalDeviceFeature.samplerAnisotropy;
     physicalDeviceFeatures.sampleRateShading = m_physicalDeviceFeature.sampleRateShading;
+    physicalDeviceFeatures.textureCompressionBC = m_physicalDeviceFeature.textureCompressionBC;
+    physicalDeviceFeatures.textureCompressionETC2 = m_physicalDeviceFeature.textureCompressionETC2;
+    physicalDeviceFeatures.textureCompressionASTC_LDR = m_physicalDeviceFeature.textureCompressionASTC_LDR;
+    VkPhysicalDeviceVulkan12Features physicalDeviceVulkan12Features = {};
+    physicalDeviceVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    physicalDeviceVulkan12Features.timelineSemaphore = VK_TRUE;
+    physicalDeviceVulkan12Features.runtimeDescriptorArray = VK_TRUE;
+    physicalDeviceVulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+    physicalDeviceVulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    physicalDeviceVulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR,
+        .pNext = &physicalDeviceVulkan12Features,
+        .synchronization2 = VK_TRUE
+    };
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR,
+        .pNext = &synchronization2Features,
+        .dynamicRendering = VK_TRUE
+    };
 
     VkDeviceCreateInfo deviceCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .pNext = VK_NULL_HANDLE,
+        .pNext = &dynamicRenderingFeatures,
         .flags = 0,
         .queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size()),
         .pQueueCreateInfos = queueCreateInfos.data(),
@@ -292,10 +554,17 @@ void Resources::createLogicalDevices()
     }
     if(vkCreateDevice(m_physicalDevice, &deviceCreateInfo, VK_NULL_HANDLE, &m_device) != VK_SUCCESS)
         throw std::runtime_error("VK ERROR: Failed to create VkDevice.");
+    if(load_vkDeviceFunctions(m_device) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to load vulkan device functions.");
     
     vkGetDeviceQueue(m_device, queueFamilyIndices.graphicFamily.value(), 0, &m_graphicQueue);
     vkGetDeviceQueue(m_device, queueFamilyIndices.presentFamily.value(), 0, &m_vkPresentQueue);
     vkGetDeviceQueue(m_device, queueFamilyIndices.graphicComputeFamily.value(), 0, &m_graphicComputeQueue);
+    vkGetDeviceQueue(m_device, queueFamilyIndices.asyncComputeFamily(), 0, &m_computeQueue);
+    m_graphicQueueFamily = queueFamilyIndices.graphicFamily.value();
+    m_computeQueueFamily = queueFamilyIndices.asyncComputeFamily();
+    if(queueFamilyIndices.computeFamily.has_value())
+        std::cout << "VK INFO: Particle simulation runs on dedicated compute queue family " << m_computeQueueFamily << ".\n";
 }
 
 void Resources::createSwapChain()
@@ -309,14 +578,37 @@ void Resources::createSwapChain()
     VkSwapchainCreateInfoKHR swapChainCreateInfo = {};
     swapChainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
     swapChainCreateInfo.surface = m_vkSurface;
-    swapChainCreateInfo.minImageCount = std::clamp(swapChainSurpportedDetails.surfaceCapabilities.minImageCount + 1, 
-        swapChainSurpportedDetails.surfaceCapabilities.minImageCount,
-        swapChainSurpportedDetails.surfaceCapabilities.maxImageCount);
+    // maxImageCount 0 means there is no upper limit
+    uint32_t minImageCount = swapChainSurpportedDetails.surfaceCapabilities.minImageCount,
+        maxImageCount = swapChainSurpportedDetails.surfaceCapabilities.maxImageCount == 0 ? 
+            std::numeric_limits<uint32_t>::max() : swapChainSurpportedDetails.surfaceCapabilities.maxImageCount;
+    swapChainCreateInfo.minImageCount = std::clamp(m_swapChainImageCount != 0 ? m_swapChainImageCount : minImageCount + 1, 
+        minImageCount, maxImageCount);
     swapChainCreateInfo.imageFormat = m_swapChainImageFormat;  // VK_FORMAT_B8G8R8A8_SRGB
     swapChainCreateInfo.imageColorSpace = surfaceFormat.colorSpace; // CVK_COLOR_SPACE_SRGB_NONLINEAR_KHR
     swapChainCreateInfo.imageExtent = m_swapChainImageExtent;
     swapChainCreateInfo.imageArrayLayers = 1;
     swapChainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // Frame capture copies the rendered image out of the swap chain
+    if(swapChainSurpportedDetails.surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+        swapChainCreateInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    // Dynamic resolution blits the scene up into the swap chain
+    if(m_targetFrameTime > 0.f)
+    {
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(m_physicalDevice, m_swapChainImageFormat, &formatProperties);
+        VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | 
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        if((swapChainSurpportedDetails.surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) &&
+            (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures)
+            swapChainCreateInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        else
+        {
+            std::cout << "VK INFO: Swap chain images can't be linearly blitted to, dynamic resolution is disabled.\n";
+            m_targetFrameTime = 0.f;
+        }
+    }
+    m_swapChainImageUsage = swapChainCreateInfo.imageUsage;
 
     RequiredQueueFamilyIndices requiredQueueFamilyIndices = queryRequiredQueueFamilies(m_physicalDevice, m_vkSurface);
     std::vector<uint32_t> queueFamilyIndices = requiredQueueFamilyIndices.getAllFamilyIndices();
@@ -336,7 +628,7 @@ void Resources::createSwapChain()
     swapChainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     swapChainCreateInfo.presentMode = m_presentMode;
     swapChainCreateInfo.clipped = VK_TRUE;
-    swapChainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+    swapChainCreateInfo.oldSwapchain = m_vkSwapChain;  // VK_NULL_HANDLE on the first call, lets the driver hand over resources
 
     if(vkCreateSwapchainKHR(m_device, &swapChainCreateInfo, VK_NULL_HANDLE, &m_vkSwapChain) != VK_SUCCESS)
         throw std::runtime_error("VK ERROR: Failed to create VkSwapChainKHR.");
@@ -354,13 +646,62 @@ void Resources::createSwapChainImageViews()
         createImageView(m_swapChainImageViews[i], m_swapChainImages[i], m_swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
 }
 
-void Resources::createDepthResources()
+void Resources::createRenderGraph()
 {
+    // The MSAA and depth images themselves are transients of the graph, allocated when the first frame is recorded
     m_depthStencilImageFormat = findSupportedFormat({VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, 
         VK_FORMAT_D24_UNORM_S8_UINT}, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
-    createImage(m_swapChainImageExtent.width, m_swapChainImageExtent.height, m_depthStencilImageFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 1, 
-        m_MSAASampleCount, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthStencilImage, m_depthStencilImageMemory);
-    createImageView(m_depthStencilImageView, m_depthStencilImage, m_depthStencilImageFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+    m_attachmentExtent = m_swapChainImageExtent;
+    updateRenderExtent();
+    m_renderGraph = new RenderGraph(m_device);
+    reportAttachmentMemory();
+}
+
+void Resources::reportAttachmentMemory() const
+{
+    // What the MSAA color and depth attachments would cost at 3840x2160 with 8x MSAA (or the most this device has)
+    VkSampleCountFlagBits sampleCount = std::min(VK_SAMPLE_COUNT_8_BIT, getMSAASampleCount());
+    VkDeviceSize attachmentSize = 0;
+    bool lazilyAllocated = true;
+    for(auto [format, usage]: std::vector<std::pair<VkFormat, VkImageUsageFlags>>({
+        {m_swapChainImageFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT}, 
+        {m_depthStencilImageFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT}}))
+    {
+        VkImageCreateInfo imageCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .pNext = VK_NULL_HANDLE,
+            .flags = 0,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = format,
+            .extent = {3840, 2160, 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = sampleCount,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = VK_NULL_HANDLE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+        };
+        // The probe is informational only, a device that can't create it still renders at its own resolution
+        VkImage image;
+        if(vkCreateImage(m_device, &imageCreateInfo, VK_NULL_HANDLE, &image) != VK_SUCCESS)
+        {
+            std::cout << "VK INFO: Could not create a 3840x2160 " << sampleCount << "x attachment probe, skipped the memory report.\n";
+            return;
+        }
+        VkMemoryRequirements memoryRequirements;
+        vkGetImageMemoryRequirements(m_device, image, &memoryRequirements);
+        vkDestroyImage(m_device, image, VK_NULL_HANDLE);
+        attachmentSize += memoryRequirements.size;
+        lazilyAllocated = lazilyAllocated && 
+            tryFindMemoryTypeIndex(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT).has_value();
+    }
+    std::cout << "VK INFO: MSAA color and depth at 3840x2160 with " << sampleCount << "x MSAA take " << 
+        attachmentSize / (1024.f * 1024.f) << " MiB, " << (lazilyAllocated ? 
+            "lazily allocated memory saves all of it as long as the attachments stay on chip.\n" : 
+            "this device has no lazily allocated memory, they stay in device local memory.\n");
 }
 
 void Resources::createCommandPool()
@@ -377,11 +718,44 @@ void Resources::createCommandPool()
     VkCommandPoolCreateInfo computeCommandPoolCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
         .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-        .queueFamilyIndex = requriedQueueFamilyIndices.graphicComputeFamily.value()
+        .queueFamilyIndex = requriedQueueFamilyIndices.asyncComputeFamily()
     };
     if((vkCreateCommandPool(m_device, &graphicCommandPoolCreateInfo, VK_NULL_HANDLE, &m_graphicCommandPool) != VK_SUCCESS) || 
         (vkCreateCommandPool(m_device, &computeCommandPoolCreateInfo, VK_NULL_HANDLE, &m_computeCommandPool) != VK_SUCCESS))
         throw std::runtime_error("VK ERROR: Failed to create graphic command pool.");
+
+    // Cached draw command buffers of a frame index are invalidated together, each frame index gets its own pool
+    if(m_cacheDrawCommands)
+    {
+        // Secondary command buffers are recycled every frame, they can't be referenced by cached primaries
+        if(m_recordThreadCount != 0)
+            std::cout << "VK INFO: --cache-commands records on the main thread, --record-threads is ignored.\n";
+        m_recordThreadCount = 0;
+        VkCommandPoolCreateInfo cacheCommandPoolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = 0,
+            .queueFamilyIndex = requriedQueueFamilyIndices.graphicFamily.value()
+        };
+        m_drawCommandCaches.resize(m_maxInflightFrames);
+        for(DrawCommandCache& cache: m_drawCommandCaches)
+            if(vkCreateCommandPool(m_device, &cacheCommandPoolCreateInfo, VK_NULL_HANDLE, &cache.commandPool) != VK_SUCCESS)
+                throw std::runtime_error("VK ERROR: Failed to create draw command cache pool.");
+    }
+
+    // Command pools are not thread safe, every recording thread gets its own one per frame in flight
+    if(m_recordThreadCount == 0)
+        return;
+    m_recordThreadPool = new ThreadPool(m_recordThreadCount);
+    VkCommandPoolCreateInfo recordCommandPoolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,  // Whole pools are reset every frame
+        .queueFamilyIndex = requriedQueueFamilyIndices.graphicFamily.value()
+    };
+    m_recordContexts.resize(m_maxInflightFrames, std::vector<RecordContext>(m_recordThreadCount));
+    for(std::vector<RecordContext>& frameRecordContexts: m_recordContexts)
+        for(RecordContext& recordContext: frameRecordContexts)
+            if(vkCreateCommandPool(m_device, &recordCommandPoolCreateInfo, VK_NULL_HANDLE, &recordContext.commandPool) != VK_SUCCESS)
+                throw std::runtime_error("VK ERROR: Failed to create recording thread command pool.");
 }
 
 void Resources::allocateCommandBuffers()
@@ -413,7 +787,7 @@ void Resources::allocateCommandBuffers()
 
 void Resources::createDescriptorSetLayout()
 {
-    // Descriptor set for drawing scene
+    // Descriptor set for drawing scene, textures live in the bindless set
     VkDescriptorSetLayoutBinding drawSetPBindings[2] = {
         // mvp matrices
         {
@@ -423,12 +797,12 @@ void Resources::createDescriptorSetLayout()
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
             .pImmutableSamplers = VK_NULL_HANDLE
         },
-        // texture
+        // per-draw data, each draw selects its entry of the ring with a dynamic offset
         {
             .binding = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
-            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
             .pImmutableSamplers = VK_NULL_HANDLE
         }
     };
@@ -441,6 +815,43 @@ void Resources::createDescriptorSetLayout()
     if(vkCreateDescriptorSetLayout(m_device, &drawDescriptorSetLayoutCreateInfo, VK_NULL_HANDLE, &m_graphicDescriptorSetLayout) != VK_SUCCESS)
         throw std::runtime_error("VK ERROR: Failed to create VkDescriptorSetLayout.");
 
+    // Bindless set, shared by all frames. Slots are written while frames using other slots are in flight.
+    VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties = {};
+    descriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 physicalDeviceProperties2 = {};
+    physicalDeviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    physicalDeviceProperties2.pNext = &descriptorIndexingProperties;
+    vkGetPhysicalDeviceProperties2(m_physicalDevice, &physicalDeviceProperties2);
+    m_bindlessTextureCapacity = std::min({m_bindlessTextureCapacity,
+        descriptorIndexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        descriptorIndexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+        descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+        descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindSamplers});
+    VkDescriptorSetLayoutBinding bindlessBinding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = m_bindlessTextureCapacity,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .pImmutableSamplers = VK_NULL_HANDLE
+    };
+    VkDescriptorBindingFlags bindlessBindingFlags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | 
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .bindingCount = 1,
+        .pBindingFlags = &bindlessBindingFlags
+    };
+    VkDescriptorSetLayoutCreateInfo bindlessDescriptorSetLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &bindingFlagsCreateInfo,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+        .bindingCount = 1,
+        .pBindings = &bindlessBinding
+    };
+    if(vkCreateDescriptorSetLayout(m_device, &bindlessDescriptorSetLayoutCreateInfo, VK_NULL_HANDLE, &m_bindlessDescriptorSetLayout) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to create bindless VkDescriptorSetLayout.");
+
     // Descriptor set for updating particle status
     m_particles->createDescriptorSetLayout();
 }
@@ -449,18 +860,27 @@ void Resources::createParticlesDescriptorSetLayout(VkDescriptorSetLayout& comput
     VkDescriptorSetLayout& graphicDescriptorSetLayout) const
 {
     // Create graphic descriptorset layout
-    VkDescriptorSetLayoutBinding pGraphicBindings[1] ={
+    VkDescriptorSetLayoutBinding pGraphicBindings[2] ={
+        // mvp matrices
         {
             .binding = 0, 
             .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
             .pImmutableSamplers = VK_NULL_HANDLE
+        },
+        // interpolation alpha
+        {
+            .binding = 1, 
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .pImmutableSamplers = VK_NULL_HANDLE
         }
     };
     VkDescriptorSetLayoutCreateInfo graphicDescriptorSetLayoutCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-        .bindingCount = 1,
+        .bindingCount = 2,
         .pBindings = pGraphicBindings
     };
     if(vkCreateDescriptorSetLayout(m_device, &graphicDescriptorSetLayoutCreateInfo, VK_NULL_HANDLE, &graphicDescriptorSetLayout) != VK_SUCCESS)
@@ -502,105 +922,117 @@ void Resources::createParticlesDescriptorSetLayout(VkDescriptorSetLayout& comput
         throw std::runtime_error("VK ERROR: Failed to create descriptor set layout for particle compute pipeline.");
 }
 
-void Resources::createRenderPass()
-{
-    VkAttachmentDescription colorAttachmentDescription = {
-        .format = m_swapChainImageFormat,
-        .samples = m_MSAASampleCount,
-        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,  // What to do before the renderpass for color&depth attachment
-        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,  // What to do after the renderpass for color&depth attachment
-        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,  // What to do before the renderpass for stencil attachment
-        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,  // What to do after the renderpass for stencil attachment
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,  // Image layout before the renderpass
-        .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL  // Image layout after the renderpass
-    };
-    VkAttachmentDescription depthStencilAttachmentDescription = {
-        .format = m_depthStencilImageFormat,
-        .samples = m_MSAASampleCount,
-        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
-    };
-    VkAttachmentDescription resolveAttachmentDescription = {
-        .format = m_swapChainImageFormat,
-        .samples = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-    };
-    VkAttachmentDescription attachmentDescriptions[3] = {colorAttachmentDescription, depthStencilAttachmentDescription, resolveAttachmentDescription};
-
-    VkAttachmentReference colorAttachmentReference = {
-        .attachment = 0,  // index corresponding renderPassCreateInfo.pAttachments
-        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL  // Image layout during the render pass
-    };
-    VkAttachmentReference depthStencilAttachmentReference = {
-        .attachment = 1,
-        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
-    };
-    VkAttachmentReference resolveAttachmentReference = {
-        .attachment = 2,
-        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-    };
-
-    VkSubpassDescription subpassDescription = {
-        .flags = 0,
-        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-        .inputAttachmentCount = 0,
-        .pInputAttachments = VK_NULL_HANDLE,
-        .colorAttachmentCount = 1,
-        .pColorAttachments = &colorAttachmentReference,
-        .pResolveAttachments = &resolveAttachmentReference,
-        .pDepthStencilAttachment = &depthStencilAttachmentReference,
-        .preserveAttachmentCount = 0,
-        .pPreserveAttachments = VK_NULL_HANDLE
-    };
+void Resources::createPipelineManager()
+{
+    m_pipelineManager = new PipelineManager(m_device, 
+        [this](ShaderPipeline pipeline, const PipelineKey& key)
+        {
+            return buildPipeline(pipeline, key);
+        },
+        [this](const PipelineKey& key, const PipelineKey& currentKey)
+        {
+            warmUpPipelines(key, currentKey);
+        },
+        m_pipelineManifestPath);
+}
 
-    VkSubpassDependency subpassDependency;
-    subpassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    subpassDependency.dstSubpass = 0;
-    subpassDependency.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-    subpassDependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-    subpassDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-    subpassDependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-    subpassDependency.dependencyFlags = 0;
+void Resources::createPipeline()
+{
+    createPipeline(currentPipelineKey());
+}
 
-    VkRenderPassCreateInfo renderPassCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-        .attachmentCount = 3,
-        .pAttachments = attachmentDescriptions,
-        .subpassCount = 1,
-        .pSubpasses = &subpassDescription,
-        .dependencyCount = 1,
-        .pDependencies = &subpassDependency
-    };
+void Resources::createPipeline(const PipelineKey& key)
+{
+    // Every pipeline compiles on its own worker against the shared pipeline cache, while the main thread goes on 
+    // loading assets and drawing. The new set is installed as a whole once every pipeline of it is done; until then 
+    // frames keep drawing with the previous set, or nothing but the clear color before the first one.
+    std::vector<ShaderPipeline> pipelines = {ShaderPipeline::Scene, ShaderPipeline::ParticleGraphic, ShaderPipeline::ParticleCompute};
+    if(m_depthPrepass)
+        pipelines.push_back(ShaderPipeline::DepthPrepass);
+    m_pipelineManager->buildSet(pipelines, key);
+}
 
-    if(vkCreateRenderPass(m_device, &renderPassCreateInfo, VK_NULL_HANDLE, &m_renderPass) != VK_SUCCESS)
-        throw std::runtime_error("VK ERROR: Failed to create VkRenderPass");
+PipelineKey Resources::currentPipelineKey() const
+{
+    return {m_MSAASampleCount, m_swapChainImageFormat, m_depthStencilImageFormat};
 }
 
-void Resources::createPipeline()
+PipelineSwap Resources::buildPipeline(ShaderPipeline pipeline, const PipelineKey& key) const
+{
+    // Runs on a pipeline worker and only hands back the new handles, the main thread installs them between frames
+    PipelineSwap pipelineSwap = {.pipeline = pipeline, .key = key, .handle = VK_NULL_HANDLE, .layout = VK_NULL_HANDLE, .generation = 0};
+    if(pipeline == ShaderPipeline::Scene)
+        createScenePipeline(pipelineSwap.handle, pipelineSwap.layout, key.sampleCount, key.colorFormat, key.depthFormat);
+    else if(pipeline == ShaderPipeline::DepthPrepass)
+        createScenePipeline(pipelineSwap.handle, pipelineSwap.layout, key.sampleCount, key.colorFormat, key.depthFormat, true);
+    else if(pipeline == ShaderPipeline::ParticleGraphic)
+        createParticleGraphicPipeline(pipelineSwap.handle, pipelineSwap.layout, m_particles->graphicDescriptorSetLayout(),
+            key.sampleCount, key.colorFormat, key.depthFormat);
+    else
+        createParticleComputePipeline(pipelineSwap.handle, pipelineSwap.layout, m_particles->computeDescriptorSetLayout());
+    return pipelineSwap;
+}
+
+std::vector<std::string> Resources::pipelineShaders(ShaderPipeline pipeline) const
+{
+    // SPIR-V a pipeline is built from in stage order, hot reload rebuilds the pipelines whose list has a changed one
+    if(pipeline == ShaderPipeline::Scene)
+        return {"albedo_vert.spv", m_overdrawView ? "overdraw_frag.spv" : "albedo_frag.spv"};
+    else if(pipeline == ShaderPipeline::DepthPrepass)
+        return {"depth_vert.spv"};
+    else if(pipeline == ShaderPipeline::ParticleGraphic)
+        return {"particles_vert.spv", "particles_frag.spv"};
+    return {"updateParticle_comp.spv"};
+}
+
+void Resources::warmUpPipelines(const PipelineKey& key, const PipelineKey& currentKey) const
+{
+    // Formats depend on the device and surface, a manifest written on another machine may list unusable ones
+    if(key.colorFormat != currentKey.colorFormat || key.depthFormat != currentKey.depthFormat || key.sampleCount > getMSAASampleCount())
+        return;
+    VkPipeline pipeline;
+    VkPipelineLayout pipelineLayout;
+    createScenePipeline(pipeline, pipelineLayout, key.sampleCount, key.colorFormat, key.depthFormat);
+    vkDestroyPipeline(m_device, pipeline, VK_NULL_HANDLE);
+    vkDestroyPipelineLayout(m_device, pipelineLayout, VK_NULL_HANDLE);
+    if(m_depthPrepass)
+    {
+        createScenePipeline(pipeline, pipelineLayout, key.sampleCount, key.colorFormat, key.depthFormat, true);
+        vkDestroyPipeline(m_device, pipeline, VK_NULL_HANDLE);
+        vkDestroyPipelineLayout(m_device, pipelineLayout, VK_NULL_HANDLE);
+    }
+    m_particles->warmUpGraphicPipeline(key.sampleCount, key.colorFormat, key.depthFormat);
+}
+
+void Resources::createScenePipeline(VkPipeline& pipeline, VkPipelineLayout& pipelineLayout, 
+    VkSampleCountFlagBits sampleCount, VkFormat colorFormat, VkFormat depthFormat, bool depthOnly) const
 {
-    //// Create graphic pipeline for drawing scene
+    //// Create graphic pipeline for drawing scene, or with depthOnly for the depth pre-pass: positions only and no 
+    //// fragment shader
     // Create info for Shader stage
-    std::vector<char> vertexShaderBytes = readShaderFile("./shaders/albedo_vert.spv");
-    std::vector<char> fragmentShaderBytes = readShaderFile("./shaders/albedo_frag.spv");
-    
-    VkShaderModule vertexShaderModule = createShaderModule(vertexShaderBytes);
-    VkShaderModule fragmentShaderModule = createShaderModule(fragmentShaderBytes);
+    std::vector<std::string> shaders = pipelineShaders(depthOnly ? ShaderPipeline::DepthPrepass : ShaderPipeline::Scene);
+    VkShaderModule vertexShaderModule = createShaderModule(shaders[0]);
+    VkShaderModule fragmentShaderModule = depthOnly ? VK_NULL_HANDLE : createShaderModule(shaders[1]);
     
+    // constant_id 0 selects where the vertex shader reads the per-draw transform from
+    VkBool32 perDrawPushConstants = m_perDrawPushConstants;
+    VkSpecializationMapEntry specializationMapEntry = {
+        .constantID = 0,
+        .offset = 0,
+        .size = sizeof(VkBool32)
+    };
+    VkSpecializationInfo specializationInfo = {
+        .mapEntryCount = 1,
+        .pMapEntries = &specializationMapEntry,
+        .dataSize = sizeof(VkBool32),
+        .pData = &perDrawPushConstants
+    };
     VkPipelineShaderStageCreateInfo vertexShaderStageCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
         .stage = VK_SHADER_STAGE_VERTEX_BIT,
         .module = vertexShaderModule,
         .pName = "main",  // Entry point
-        .pSpecializationInfo = VK_NULL_HANDLE  // This member is useful in some cases
+        .pSpecializationInfo = &specializationInfo
     };
     VkPipelineShaderStageCreateInfo fragmentShaderStageCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
@@ -637,7 +1069,7 @@ void Resources::createPipeline()
     vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     vertexInputCreateInfo.vertexBindingDescriptionCount = 1;
     vertexInputCreateInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputCreateInfo.vertexAttributeDescriptionCount = 3;
+    vertexInputCreateInfo.vertexAttributeDescriptionCount = depthOnly ? 1 : 3;
     vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions;
 
     // Create info for input assembly state
@@ -661,7 +1093,13 @@ void Resources::createPipeline()
     viewportStateCreateInfo.scissorCount = 1;
 
     // Create graphic pipeline layout
-    createPipelineLayout(m_graphicPipelineLayout, m_graphicDescriptorSetLayout);
+    // Set 0 is per frame, set 1 bindless. The transform (with --per-draw-data push) and texture index are pushed per draw.
+    VkPushConstantRange pushConstantRanges[2] = {
+        {.stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .offset = 0, .size = sizeof(glm::mat4)},
+        {.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT, .offset = sizeof(glm::mat4), .size = sizeof(uint32_t)}
+    };
+    createPipelineLayout(pipelineLayout, {m_graphicDescriptorSetLayout, m_bindlessDescriptorSetLayout}, 
+        {pushConstantRanges[0], pushConstantRanges[1]});
 
     // Create info for rasterization state
     VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo = {};
@@ -680,9 +1118,9 @@ void Resources::createPipeline()
     // Create info for multisample state(Disabled for now)
     VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo = {};
     multisampleStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampleStateCreateInfo.rasterizationSamples = m_MSAASampleCount;  // 1 sample means multisample disabled
-    multisampleStateCreateInfo.sampleShadingEnable = m_physicalDeviceFeature.sampleRateShading;
-    multisampleStateCreateInfo.minSampleShading = 0.25f;
+    multisampleStateCreateInfo.rasterizationSamples = sampleCount;  // 1 sample means multisample disabled
+    multisampleStateCreateInfo.sampleShadingEnable = m_physicalDeviceFeature.sampleRateShading && m_sceneMinSampleShading > 0.f;
+    multisampleStateCreateInfo.minSampleShading = m_sceneMinSampleShading;
     multisampleStateCreateInfo.pSampleMask = VK_NULL_HANDLE; // VK_NULL_HANDLE means do not mask any sample
     multisampleStateCreateInfo.alphaToCoverageEnable = VK_FALSE;  // optional
     multisampleStateCreateInfo.alphaToOneEnable = VK_FALSE;  // optional
@@ -693,8 +1131,8 @@ void Resources::createPipeline()
         .pNext = VK_NULL_HANDLE,
         .flags = 0,
         .depthTestEnable = VK_TRUE,
-        .depthWriteEnable = VK_TRUE,
-        .depthCompareOp = VK_COMPARE_OP_LESS,
+        .depthWriteEnable = depthOnly || !m_depthPrepass,
+        .depthCompareOp = depthOnly || !m_depthPrepass ? VK_COMPARE_OP_LESS : VK_COMPARE_OP_EQUAL,  // After the pre-pass only the visible surface passes
         .depthBoundsTestEnable = VK_FALSE,
         .stencilTestEnable = VK_FALSE,
         .front = {},
@@ -716,6 +1154,17 @@ void Resources::createPipeline()
         VK_COLOR_COMPONENT_G_BIT |
         VK_COLOR_COMPONENT_B_BIT |
         VK_COLOR_COMPONENT_A_BIT;  // This means: finalcolor = finalcolor & 0xFFFFFFFF
+    if(m_overdrawView)
+    {
+        // Every shaded fragment adds its constant, so the result counts the fragments per pixel
+        colorBlendAttachmentState.blendEnable = VK_TRUE;
+        colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    }
+    if(depthOnly)
+        colorBlendAttachmentState.colorWriteMask = 0;  // Without a fragment shader there is no color to write
     
     VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo = {};
     colorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -728,10 +1177,22 @@ void Resources::createPipeline()
     colorBlendStateCreateInfo.blendConstants[2] = 0.f;  // optional
     colorBlendStateCreateInfo.blendConstants[3] = 0.f;  // optional
 
+    // Attachment formats the pipeline renders to, there is no render pass object
+    VkPipelineRenderingCreateInfoKHR pipelineRenderingCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+        .pNext = VK_NULL_HANDLE,
+        .viewMask = 0,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &colorFormat,
+        .depthAttachmentFormat = depthFormat,
+        .stencilAttachmentFormat = VK_FORMAT_UNDEFINED
+    };
+
     // Create info for graphic pipeline
     VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .stageCount = 2,
+        .pNext = &pipelineRenderingCreateInfo,
+        .stageCount = depthOnly ? 1u : 2u,
         .pStages = shaderStageCreateInfos,
         .pVertexInputState = &vertexInputCreateInfo,
         .pInputAssemblyState = &inputAssemblyStateCreateInfo,
@@ -742,72 +1203,101 @@ void Resources::createPipeline()
         .pDepthStencilState = &depthStencilStateCreateInfo,
         .pColorBlendState = &colorBlendStateCreateInfo,
         .pDynamicState = &dynamicStateCreateInfo,
-        .layout = m_graphicPipelineLayout,
-        .renderPass = m_renderPass,
-        .subpass = 0,  // subpass index
+        .layout = pipelineLayout,
+        .renderPass = VK_NULL_HANDLE,
+        .subpass = 0,
         .basePipelineHandle = VK_NULL_HANDLE,
         .basePipelineIndex = -1
     };  
 
     if(vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, 
-        &graphicsPipelineCreateInfo, VK_NULL_HANDLE, &m_graphicPipeline) != VK_SUCCESS)
+        &graphicsPipelineCreateInfo, VK_NULL_HANDLE, &pipeline) != VK_SUCCESS)
         throw std::runtime_error("VK ERROR: Failed to create graphic pipeline for rendering scene.");
 
     vkDestroyShaderModule(m_device, vertexShaderModule, VK_NULL_HANDLE);
-    vkDestroyShaderModule(m_device, fragmentShaderModule, VK_NULL_HANDLE);
-
-    //// Create graphic pipeline for drawing particles
-    m_particles->createGraphicPipeline();
-
-    //// Create compute pipeline for updating particles
-    m_particles->createComputePipeline();
-}
-
-void Resources::createSwapChainFrameBuffers()
-{
-    m_swapChainFrameBuffers.resize(m_swapChainImageViews.size());
-    for(uint32_t i = 0; i < m_swapChainImageViews.size(); ++i)
-    {
-        VkImageView frameBufferImageViews[3] = {m_colorMSAAImageView, m_depthStencilImageView, m_swapChainImageViews[i]};
-
-        VkFramebufferCreateInfo framebufferCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-            .renderPass = m_renderPass,
-            .attachmentCount = 3,
-            .pAttachments = frameBufferImageViews,
-            .width = m_swapChainImageExtent.width,
-            .height =  m_swapChainImageExtent.height,
-            .layers = 1
-        };
-    
-        if(vkCreateFramebuffer(m_device, &framebufferCreateInfo, VK_NULL_HANDLE, &m_swapChainFrameBuffers[i]) != VK_SUCCESS)
-            throw std::runtime_error("VK ERROR: Failed to create VkFrameBuffer.");
-    }
+    if(fragmentShaderModule != VK_NULL_HANDLE)
+        vkDestroyShaderModule(m_device, fragmentShaderModule, VK_NULL_HANDLE);
 }
 
 void Resources::createSyncObjects()
 {
     m_acquireImageSemaphores.resize(m_maxInflightFrames);
     m_drawSemaphores.resize(m_maxInflightFrames);
-    m_graphicInFlightFences.resize(m_maxInflightFrames);
-    m_computeCompleteSemaphores.resize(m_maxInflightFrames);
-    m_computeInFlightFences.resize(m_maxInflightFrames);
+    m_particleAcquirePending.assign(m_maxInflightFrames, false);
 
     VkSemaphoreCreateInfo semaphoreCreateInfo = {};
     semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-    VkFenceCreateInfo fenceCreateInfo = {};
-    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
     for(uint32_t i = 0; i < m_maxInflightFrames; ++i)
     {
         if((vkCreateSemaphore(m_device, &semaphoreCreateInfo, VK_NULL_HANDLE, &m_acquireImageSemaphores[i]) != VK_SUCCESS) ||
-            (vkCreateSemaphore(m_device, &semaphoreCreateInfo, VK_NULL_HANDLE, &m_drawSemaphores[i]) != VK_SUCCESS) || 
-            (vkCreateFence(m_device, &fenceCreateInfo, VK_NULL_HANDLE, &m_graphicInFlightFences[i]) != VK_SUCCESS) ||
-            (vkCreateSemaphore(m_device, &semaphoreCreateInfo, VK_NULL_HANDLE, &m_computeCompleteSemaphores[i]) != VK_SUCCESS) ||
-            (vkCreateFence(m_device, &fenceCreateInfo, VK_NULL_HANDLE, &m_computeInFlightFences[i]) != VK_SUCCESS))
-            throw std::runtime_error("VK ERROR: Failed to create VkSemaphore or VkFence.");
+            (vkCreateSemaphore(m_device, &semaphoreCreateInfo, VK_NULL_HANDLE, &m_drawSemaphores[i]) != VK_SUCCESS))
+            throw std::runtime_error("VK ERROR: Failed to create VkSemaphore.");
+    }
+
+    VkSemaphoreTypeCreateInfo timelineCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0
+    };
+    VkSemaphoreCreateInfo timelineSemaphoreCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &timelineCreateInfo,
+        .flags = 0
+    };
+    if(vkCreateSemaphore(m_device, &timelineSemaphoreCreateInfo, VK_NULL_HANDLE, &m_graphicTimeline) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to create graphic timeline semaphore.");
+    // The particle SSBO of the first frame already holds the initial state, so the compute timeline starts at 1
+    timelineCreateInfo.initialValue = 1;
+    if(vkCreateSemaphore(m_device, &timelineSemaphoreCreateInfo, VK_NULL_HANDLE, &m_computeTimeline) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to create compute timeline semaphore.");
+}
+
+uint64_t Resources::completedFrameSerial() const
+{
+    uint64_t value;
+    if(vkGetSemaphoreCounterValue(m_device, m_graphicTimeline, &value) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to get graphic timeline semaphore value.");
+    return value;
+}
+
+void Resources::createTimestampQueryPool()
+{
+    m_timestampsWritten.assign(m_maxInflightFrames, false);
+    m_timestampSampleCounts.assign(m_maxInflightFrames, VK_SAMPLE_COUNT_1_BIT);
+
+    // Both queues have to write timestamps, otherwise overlap can't be measured
+    uint32_t queueFamilyCount;
+    vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, VK_NULL_HANDLE);
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, queueFamilyProperties.data());
+    uint32_t validBits = std::min(queueFamilyProperties[m_graphicQueueFamily].timestampValidBits, 
+        queueFamilyProperties[m_computeQueueFamily].timestampValidBits);
+    if(validBits == 0)
+    {
+        std::cout << "VK INFO: Timestamps are not supported on the graphic and compute queues, async compute overlap won't be measured.\n";
+        if(m_targetFrameTime > 0.f)
+        {
+            std::cout << "VK INFO: Dynamic resolution needs GPU timestamps and is disabled.\n";
+            m_targetFrameTime = 0.f;
+            m_renderScale = 1.f;
+            updateRenderExtent();
+        }
+        return;
     }
+    m_timestampMask = validBits >= 64 ? std::numeric_limits<uint64_t>::max() : (uint64_t(1) << validBits) - 1;
+
+    VkQueryPoolCreateInfo queryPoolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = 0,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 4 * m_maxInflightFrames,
+        .pipelineStatistics = 0
+    };
+    if(vkCreateQueryPool(m_device, &queryPoolCreateInfo, VK_NULL_HANDLE, &m_timestampQueryPool) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to create timestamp query pool.");
 }
 
 void Resources::createDrawUniformBuffers()
@@ -827,29 +1317,101 @@ void Resources::createDrawUniformBuffers()
         vkMapMemory(m_device, m_uniformBufferMemories[i], 0, uniformBufferSize, 0, &m_uniformBuffersMapped[i]);
     }
 
+    // One ring of per-draw data for all frames in flight, each frame writes its own slice of m_objectCount entries.
+    // Entries are padded to the dynamic offset alignment.
+    VkDeviceSize alignment = m_physicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
+    m_drawDataStride = static_cast<uint32_t>((sizeof(UBODrawData) + alignment - 1) / alignment * alignment);
+    VkDeviceSize drawDataRingSize = static_cast<VkDeviceSize>(m_drawDataStride) * m_objectCount * m_maxInflightFrames;
+    createBuffer(drawDataRingSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        m_drawDataRing, m_drawDataRingMemory);
+    vkMapMemory(m_device, m_drawDataRingMemory, 0, drawDataRingSize, 0, &m_drawDataRingMapped);
+    m_objectTransforms.resize(m_objectCount);
+
     // Create uniform buffer for compute shader(Already created while intializing particle group)
 }
 
-void Resources::createDescriptorPool()
+void Resources::createDescriptorAllocators()
 {
-    VkDescriptorPoolSize descriptorPoolSize[3];
-    descriptorPoolSize[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    descriptorPoolSize[0].descriptorCount = m_maxInflightFrames * (1 + m_particles->uniformDescriptorCount());
-    descriptorPoolSize[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    descriptorPoolSize[1].descriptorCount = m_maxInflightFrames * (1 + m_particles->combinedImageSamplerCount());
-    descriptorPoolSize[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    descriptorPoolSize[2].descriptorCount = m_maxInflightFrames * (0 + m_particles->storageDescriptorCount());
+    // Sized per set, pools grow as models and particle groups are added
+    DescriptorAllocator::PoolRatios poolRatios = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.f},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.f},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.f}
+    };
+    m_descriptorAllocator = new DescriptorAllocator(m_device, 32, poolRatios);
+}
 
+void Resources::createBindlessDescriptorSet()
+{
+    VkDescriptorPoolSize descriptorPoolSize = {.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = m_bindlessTextureCapacity};
     VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
         .pNext = VK_NULL_HANDLE,
-        .flags = 0,
-        .maxSets = m_maxInflightFrames * 3,
-        .poolSizeCount = 3,
-        .pPoolSizes = descriptorPoolSize,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &descriptorPoolSize,
+    };
+    if(vkCreateDescriptorPool(m_device, &descriptorPoolCreateInfo, VK_NULL_HANDLE, &m_bindlessDescriptorPool) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to create bindless descriptor pool.");
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .descriptorPool = m_bindlessDescriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &m_bindlessDescriptorSetLayout
+    };
+    if(vkAllocateDescriptorSets(m_device, &descriptorSetAllocateInfo, &m_bindlessDescriptorSet) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to allocate bindless VkDescriptorSet.");
+}
+
+uint32_t Resources::registerBindlessTexture(const Texture& texture)
+{
+    uint32_t index = allocateBindlessSlot(m_freeBindlessTextures, m_bindlessTextureCount, m_bindlessTextureCapacity, "texture");
+    VkDescriptorImageInfo descriptorImageInfo = {
+        .sampler = texture.sampler,
+        .imageView = texture.imageView,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+    VkWriteDescriptorSet writeDescriptorSet = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = VK_NULL_HANDLE,
+        .dstSet = m_bindlessDescriptorSet,
+        .dstBinding = 0,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &descriptorImageInfo,
+        .pBufferInfo = VK_NULL_HANDLE,
+        .pTexelBufferView = VK_NULL_HANDLE
     };
-    if(vkCreateDescriptorPool(m_device, &descriptorPoolCreateInfo, VK_NULL_HANDLE, &m_descriptorPool) != VK_SUCCESS)
-        throw std::runtime_error("VK ERROR: Failed to create descriptor pool.");
+    vkUpdateDescriptorSets(m_device, 1, &writeDescriptorSet, 0, VK_NULL_HANDLE);
+    return index;
+}
+
+void Resources::retireBindlessTexture(uint32_t index) const
+{
+    // Frames in flight may still sample the slot, it's only handed out again once they are done
+    deferDestruction([this, index]()
+    {
+        m_freeBindlessTextures.push_back(index);
+    });
+}
+
+uint32_t Resources::allocateBindlessSlot(std::vector<uint32_t>& freeSlots, uint32_t& slotCount, uint32_t capacity, const char* kind)
+{
+    if(!freeSlots.empty())
+    {
+        uint32_t index = freeSlots.back();
+        freeSlots.pop_back();
+        return index;
+    }
+    if(slotCount == capacity)
+        throw std::runtime_error("VK ERROR: All " + std::to_string(capacity) + " bindless " + kind + " slots are in use.");
+    return slotCount++;
 }
 
 void Resources::allocateDescriptorSets()
@@ -857,15 +1419,7 @@ void Resources::allocateDescriptorSets()
     // allocate graphic descriptor sets
     m_graphicDescriptorSets.resize(m_maxInflightFrames);
     std::vector<VkDescriptorSetLayout> descriptorSetLayouts(m_maxInflightFrames, m_graphicDescriptorSetLayout);
-
-    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-        .descriptorPool = m_descriptorPool,
-        .descriptorSetCount = m_maxInflightFrames,
-        .pSetLayouts = descriptorSetLayouts.data()
-    };
-    if(vkAllocateDescriptorSets(m_device, &descriptorSetAllocateInfo, m_graphicDescriptorSets.data()) != VK_SUCCESS)
-        throw std::runtime_error("VK ERROR: Failed to allocate VkDescriptorSet.");
+    m_descriptorAllocator->allocate(descriptorSetLayouts, m_graphicDescriptorSets);
     
     for(uint32_t i = 0; i < m_maxInflightFrames; ++i)
     {
@@ -874,7 +1428,11 @@ void Resources::allocateDescriptorSets()
         descriptorBufferInfo.offset = 0;
         descriptorBufferInfo.range = sizeof(UBOProjectionMatrices);
 
-        VkDescriptorImageInfo descriptorImageInfo = m_model->getTextureDescriptorImageInfo();
+        VkDescriptorBufferInfo drawDataBufferInfo = {
+            .buffer = m_drawDataRing,
+            .offset = static_cast<VkDeviceSize>(m_drawDataStride) * m_objectCount * i,  // This frame's slice of the ring
+            .range = sizeof(UBODrawData)
+        };
 
         VkWriteDescriptorSet writeDescriptorSets[2];
         writeDescriptorSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -887,16 +1445,10 @@ void Resources::allocateDescriptorSets()
         writeDescriptorSets[0].pImageInfo = VK_NULL_HANDLE;
         writeDescriptorSets[0].pBufferInfo = &descriptorBufferInfo;
         writeDescriptorSets[0].pTexelBufferView = VK_NULL_HANDLE;
-        writeDescriptorSets[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        writeDescriptorSets[1].pNext = VK_NULL_HANDLE;
-        writeDescriptorSets[1].dstSet = m_graphicDescriptorSets[i];
+        writeDescriptorSets[1] = writeDescriptorSets[0];
         writeDescriptorSets[1].dstBinding = 1;
-        writeDescriptorSets[1].dstArrayElement = 0;
-        writeDescriptorSets[1].descriptorCount = 1;
-        writeDescriptorSets[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        writeDescriptorSets[1].pImageInfo = &descriptorImageInfo;
-        writeDescriptorSets[1].pBufferInfo = VK_NULL_HANDLE;
-        writeDescriptorSets[1].pTexelBufferView = VK_NULL_HANDLE;
+        writeDescriptorSets[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        writeDescriptorSets[1].pBufferInfo = &drawDataBufferInfo;
         vkUpdateDescriptorSets(m_device, 2, writeDescriptorSets, 0, VK_NULL_HANDLE);
     }
 
@@ -963,9 +1515,9 @@ void Resources::createImage(int width, int height, VkFormat format, VkImageUsage
     vkBindImageMemory(m_device, image, imageMemory, 0);
 }
 
-void Resources::copyBuffer2Buffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) const
+void Resources::copyBuffer2Buffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, bool onComputeQueue) const
 {
-    VkCommandBuffer copyCommandBuffer = beginSingleTimeCommandBuffer();
+    VkCommandBuffer copyCommandBuffer = beginSingleTimeCommandBuffer(onComputeQueue);
 
     VkBufferCopy bufferCopy = {};
     bufferCopy.srcOffset = 0;
@@ -973,89 +1525,23 @@ void Resources::copyBuffer2Buffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDevi
     bufferCopy.size = size;
     vkCmdCopyBuffer(copyCommandBuffer, srcBuffer, dstBuffer, 1, &bufferCopy);
 
-    endSingleTimeCommandBuffer(copyCommandBuffer);
-}
-
-void Resources::copyBuffer2Image(VkBuffer srcBuffer, VkImage dstImage, uint32_t width, uint32_t height) const
-{
-    VkCommandBuffer copyCommandBuffer = beginSingleTimeCommandBuffer();
-
-    VkBufferImageCopy bufferImageCopy = {};
-    bufferImageCopy.bufferOffset = 0;
-    bufferImageCopy.bufferRowLength = 0;
-    bufferImageCopy.bufferImageHeight = 0;
-    bufferImageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    bufferImageCopy.imageSubresource.mipLevel = 0;
-    bufferImageCopy.imageSubresource.baseArrayLayer = 0;
-    bufferImageCopy.imageSubresource.layerCount = 1;
-    bufferImageCopy.imageOffset = {0, 0, 0};
-    bufferImageCopy.imageExtent = {width, height, 1};
-
-    vkCmdCopyBufferToImage(copyCommandBuffer, srcBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
-        1, &bufferImageCopy);
-
-    endSingleTimeCommandBuffer(copyCommandBuffer);
-}
-
-void Resources::transitionImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout, VkImage image, uint32_t mipLevels) const
-{
-    VkCommandBuffer transitionLayoutCommandBuffer = beginSingleTimeCommandBuffer();
-    VkAccessFlags barrierSrcAccessMask, barrierDstAccessMask;
-    VkPipelineStageFlags srcStageMask, dstStageMask;
-    VkImageAspectFlags aspect;
-
-    if(newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
-    {
-        aspect = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
-    }
-    else
-    {
-        aspect = VK_IMAGE_ASPECT_COLOR_BIT;
-    }
-
-    if(oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+    // Uploads made while frames are running are not waited on, make the data visible to the commands after them
+    if(!onComputeQueue)
     {
-        barrierSrcAccessMask = 0;
-        barrierDstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-        srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkMemoryBarrier memoryBarrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext = VK_NULL_HANDLE,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT
+        };
+        vkCmdPipelineBarrier(copyCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+            1, &memoryBarrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
     }
-    else if(oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-    {
-        barrierSrcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrierDstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-        srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    }
-    else
-        throw std::runtime_error("VK ERROR: Specified image layout transition not implemented.");
-
-    VkImageMemoryBarrier imageMemoryBarrier = {};
-    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    imageMemoryBarrier.srcAccessMask = barrierSrcAccessMask;
-    imageMemoryBarrier.dstAccessMask = barrierDstAccessMask;
-    imageMemoryBarrier.oldLayout = oldLayout;
-    imageMemoryBarrier.newLayout = newLayout;
-    imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    imageMemoryBarrier.image = image;
-    imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
-    imageMemoryBarrier.subresourceRange.levelCount = mipLevels;
-    imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
-    imageMemoryBarrier.subresourceRange.layerCount = 1;
-
-    vkCmdPipelineBarrier(transitionLayoutCommandBuffer, srcStageMask, dstStageMask, 0, 
-        0, VK_NULL_HANDLE,
-        0, VK_NULL_HANDLE,
-        1, &imageMemoryBarrier);
-    
-    endSingleTimeCommandBuffer(transitionLayoutCommandBuffer);
+    endSingleTimeCommandBuffer(copyCommandBuffer, onComputeQueue);
 }
 
-void Resources::createImageView(VkImageView& imageView, VkImage image, VkFormat format, VkImageAspectFlags aspect) const
+void Resources::createImageView(VkImageView& imageView, VkImage image, VkFormat format, VkImageAspectFlags aspect, uint32_t mipLevels) const
 {
     VkImageViewCreateInfo imageViewCreateInfo = {};
     imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -1068,7 +1554,7 @@ void Resources::createImageView(VkImageView& imageView, VkImage image, VkFormat
     imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
     imageViewCreateInfo.subresourceRange.aspectMask = aspect;
     imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-    imageViewCreateInfo.subresourceRange.levelCount = 1;
+    imageViewCreateInfo.subresourceRange.levelCount = mipLevels;
     imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
     imageViewCreateInfo.subresourceRange.layerCount = 1;
 
@@ -1078,6 +1564,15 @@ void Resources::createImageView(VkImageView& imageView, VkImage image, VkFormat
 
 uint32_t Resources::findMemoryTypeIndex(uint32_t requiredMemoryTypeBit, 
     VkMemoryPropertyFlags requiredMemoryPropertyFlags) const
+{
+    std::optional<uint32_t> memoryTypeIndex = tryFindMemoryTypeIndex(requiredMemoryTypeBit, requiredMemoryPropertyFlags);
+    if(!memoryTypeIndex.has_value())
+        throw std::runtime_error("VK ERROR: Failed to find suitable memory type.");
+    return memoryTypeIndex.value();
+}
+
+std::optional<uint32_t> Resources::tryFindMemoryTypeIndex(uint32_t requiredMemoryTypeBit, 
+    VkMemoryPropertyFlags requiredMemoryPropertyFlags) const
 {
     VkPhysicalDeviceMemoryProperties supportedMemoryProperties;
     vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &supportedMemoryProperties);
@@ -1087,14 +1582,14 @@ uint32_t Resources::findMemoryTypeIndex(uint32_t requiredMemoryTypeBit,
             ((supportedMemoryProperties.memoryTypes[i].propertyFlags & requiredMemoryPropertyFlags) == requiredMemoryPropertyFlags))
             return i;
     }
-    throw std::runtime_error("VK ERROR: Failed to find suitable memory type.");
+    return std::nullopt;
 }
 
-VkCommandBuffer Resources::beginSingleTimeCommandBuffer() const
+VkCommandBuffer Resources::beginSingleTimeCommandBuffer(bool onComputeQueue) const
 {
     VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
     commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandBufferAllocateInfo.commandPool = m_graphicCommandPool;
+    commandBufferAllocateInfo.commandPool = onComputeQueue ? m_computeCommandPool : m_graphicCommandPool;
     commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     commandBufferAllocateInfo.commandBufferCount = 1;
 
@@ -1111,7 +1606,7 @@ VkCommandBuffer Resources::beginSingleTimeCommandBuffer() const
     return singleTimeCommandBuffer;
 }
 
-void Resources::endSingleTimeCommandBuffer(VkCommandBuffer commandBuffer) const
+void Resources::endSingleTimeCommandBuffer(VkCommandBuffer commandBuffer, bool onComputeQueue) const
 {
     if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
         throw std::runtime_error("VK ERROR: Failed to end single time command buffer.");
@@ -1126,12 +1621,23 @@ void Resources::endSingleTimeCommandBuffer(VkCommandBuffer commandBuffer) const
     submitInfo.signalSemaphoreCount = 0;
     submitInfo.pSignalSemaphores = VK_NULL_HANDLE;
 
-    if(vkQueueSubmit(m_graphicQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+    VkQueue queue = onComputeQueue ? m_computeQueue : m_graphicQueue;
+    VkCommandPool commandPool = onComputeQueue ? m_computeCommandPool : m_graphicCommandPool;
+    if(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
         throw std::runtime_error("VK ERROR: Failed to submit single time command buffer.");
 
-    // Synchronization between command buffer achived by vkQueueWaitIdle
-    vkQueueWaitIdle(m_graphicQueue);
-    vkFreeCommandBuffers(m_device, m_graphicCommandPool, 1, &commandBuffer);
+    // While loading, synchronization between command buffer achived by vkQueueWaitIdle. Once frames are running, 
+    // uploads go to the graphic queue ahead of the next frame and are retired along with it.
+    if(m_complete && !onComputeQueue)
+    {
+        deferDestruction([this, commandPool, commandBuffer]()
+        {
+            vkFreeCommandBuffers(m_device, commandPool, 1, &commandBuffer);
+        });
+        return;
+    }
+    vkQueueWaitIdle(queue);
+    vkFreeCommandBuffers(m_device, commandPool, 1, &commandBuffer);
 }
 
 VKAPI_ATTR VkBool32 VKAPI_CALL Resources::debugMessageCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -1171,6 +1677,47 @@ void Resources::mouseButtonCallback(GLFWwindow* window, int button, int action,
     app->m_mouseLeftButtonDown = VK_TRUE;
 }
 
+void Resources::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    Resources* app = reinterpret_cast<Resources*>(glfwGetWindowUserPointer(window));
+    if(action != GLFW_PRESS) return;
+
+    // R reloads the model, its texture and all pipelines from disk without waiting for the device to idle
+    if(key == GLFW_KEY_R)
+        app->m_reloadRequested = VK_TRUE;
+
+    // M steps through the MSAA levels, 1x after the highest
+    if(key == GLFW_KEY_M)
+    {
+        app->m_requestedSampleCount = app->nextMSAASampleCount();
+        app->m_MSAAChangeRequested = VK_TRUE;
+    }
+
+    // V toggles between vsync and uncapped presenting, the swapchain is recreated after the current frame
+    if(key == GLFW_KEY_V)
+    {
+        bool vsync = app->m_presentMode == VK_PRESENT_MODE_FIFO_KHR || app->m_presentMode == VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+        if(vsync)
+        {
+            // FIFO_RELAXED still waits for vblank whenever the app keeps up, so it does not count as uncapped
+            std::vector<VkPresentModeKHR> presentModes = app->querySwapChainSupportedDetails(app->m_physicalDevice, app->m_vkSurface).presentModes;
+            auto supported = [&presentModes](VkPresentModeKHR presentMode)
+            {
+                return std::find(presentModes.begin(), presentModes.end(), presentMode) != presentModes.end();
+            };
+            if(!supported(VK_PRESENT_MODE_IMMEDIATE_KHR) && !supported(VK_PRESENT_MODE_MAILBOX_KHR))
+            {
+                std::cout << "VK INFO: Surface supports neither IMMEDIATE nor MAILBOX present mode, staying on vsync.\n";
+                return;
+            }
+            app->m_presentModePreference = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR};
+        }
+        else
+            app->m_presentModePreference = {VK_PRESENT_MODE_FIFO_KHR};
+        app->m_presentModeChanged = VK_TRUE;
+    }
+}
+
 bool Resources::checkInstanceValidationLayersSupported(std::vector<const char*> validationLayerNames) const
 {
     uint32_t vk_avalibleValidationLayerCount;
@@ -1253,6 +1800,20 @@ uint64_t Resources::ratePhysicalDevice(const VkPhysicalDevice& physicalDevice) c
     
     // Does this physical device suppport gemoetry shader?
     if(!physicalDeviceFeatrues.geometryShader) return 0;
+    // Does this physical device support Vulkan 1.2 timeline semaphores?Frame synchronization is built on them
+    if(physicalDeviceProperties.apiVersion < VK_API_VERSION_1_2) return 0;
+    VkPhysicalDeviceVulkan12Features physicalDeviceVulkan12Features = {};
+    physicalDeviceVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 physicalDeviceFeatures2 = {};
+    physicalDeviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    physicalDeviceFeatures2.pNext = &physicalDeviceVulkan12Features;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &physicalDeviceFeatures2);
+    if(!physicalDeviceVulkan12Features.timelineSemaphore) return 0;
+    // Does this physical device support update-after-bind descriptor arrays? Textures are bound bindless
+    if(!physicalDeviceVulkan12Features.runtimeDescriptorArray || 
+        !physicalDeviceVulkan12Features.descriptorBindingPartiallyBound ||
+        !physicalDeviceVulkan12Features.descriptorBindingUpdateUnusedWhilePending ||
+        !physicalDeviceVulkan12Features.descriptorBindingSampledImageUpdateAfterBind) return 0;
     // Does this physical device have required queue families for operations?
     // (In our case: graphic operations and presenting operatings)?
     if(!queryRequiredQueueFamilies(physicalDevice, m_vkSurface).isComplete()) return 0;
@@ -1263,6 +1824,15 @@ uint64_t Resources::ratePhysicalDevice(const VkPhysicalDevice& physicalDevice) c
     In our case: VK_KHR_swapchain) 
     */
     if(!checkDeviceExtensionSupported(m_deviceExtensionNames, physicalDevice)) return 0;
+    // Does this physical device support dynamic rendering and synchronization2?Frames are rendered without render pass objects
+    VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features = {};
+    synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {};
+    dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    dynamicRenderingFeatures.pNext = &synchronization2Features;
+    physicalDeviceFeatures2.pNext = &dynamicRenderingFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &physicalDeviceFeatures2);
+    if(!dynamicRenderingFeatures.dynamicRendering || !synchronization2Features.synchronization2) return 0;
     // Does this physical device have required swapchain details support?That is, is the avaliable swapchain compilable with our window surface?
     // (In our case: does this physical device support at least one surface format and present mode?
     if(!querySwapChainSupportedDetails(physicalDevice, m_vkSurface).isComplete()) return 0;
@@ -1341,6 +1911,18 @@ Resources::RequiredQueueFamilyIndices Resources::queryRequiredQueueFamilies(cons
         // If current physical already provides the queue families we need.If it's enough, we end the loop.
         if(requiredQueueFamilyIndices.isComplete()) break;
     }
+
+    // A compute family without graphic support usually maps to separate hardware queues, so the particle 
+    // simulation submitted to it can overlap with drawing
+    for(uint32_t i = 0; i < deviceQueueFamilyProperties.size(); ++i)
+    {
+        if((deviceQueueFamilyProperties[i].queueFlags & VK_QUEUE_COMPUTE_BIT) && 
+            !(deviceQueueFamilyProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+        {
+            requiredQueueFamilyIndices.computeFamily = i;
+            break;
+        }
+    }
     return requiredQueueFamilyIndices;
 }
 
@@ -1382,16 +1964,12 @@ VkSurfaceFormatKHR Resources::chooseSwapChainSurfaceFormat(std::vector<VkSurface
 
 VkPresentModeKHR Resources::chooseSwapChainPresentMode(std::vector<VkPresentModeKHR> avalibalePresentModes) const
 {
-    for(const VkPresentModeKHR& presentMode: avalibalePresentModes)
-    {
-        // Our top prefered present mode is VK_PRESENT_MODE_MAILBOX_KHR
-        if(presentMode == VK_PRESENT_MODE_MAILBOX_KHR)
-            return presentMode;
-        // Else we choose VK_PRESENT_MODE_FIFO_KHR
-        else if(presentMode == VK_PRESENT_MODE_FIFO_KHR)
-            return presentMode;
-    }
-    return avalibalePresentModes[0];
+    // Take the first mode of the preference list the surface supports
+    for(VkPresentModeKHR preferredPresentMode: m_presentModePreference)
+        if(std::find(avalibalePresentModes.begin(), avalibalePresentModes.end(), preferredPresentMode) != avalibalePresentModes.end())
+            return preferredPresentMode;
+    // VK_PRESENT_MODE_FIFO_KHR is the only mode every surface has to support
+    return VK_PRESENT_MODE_FIFO_KHR;
 }
 
 VkExtent2D Resources::chooseSwapchainExtent(VkSurfaceCapabilitiesKHR surfaceCapabilities) const
@@ -1432,8 +2010,7 @@ void Resources::createParticleComputePipeline(VkPipeline& computePipeline,
         VkPipelineLayout& computePipelineLayout, 
         VkDescriptorSetLayout computeDescriptorSetLayout) const
 {
-    std::vector<char> computeShaderBytes = readShaderFile("./shaders/updateParticle_comp.spv");
-    VkShaderModule computeShaderModule = createShaderModule(computeShaderBytes);
+    VkShaderModule computeShaderModule = createShaderModule(pipelineShaders(ShaderPipeline::ParticleCompute)[0]);
     VkPipelineShaderStageCreateInfo computeShaderStageCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
         .stage = VK_SHADER_STAGE_COMPUTE_BIT,
@@ -1442,7 +2019,7 @@ void Resources::createParticleComputePipeline(VkPipeline& computePipeline,
         .pSpecializationInfo = VK_NULL_HANDLE
     };
 
-    createPipelineLayout(computePipelineLayout, computeDescriptorSetLayout);
+    createPipelineLayout(computePipelineLayout, {computeDescriptorSetLayout});
 
     VkComputePipelineCreateInfo computePipelineCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
@@ -1475,12 +2052,29 @@ std::vector<char> Resources::readShaderFile(const std::string filePath) const
     return buffer;
 }
 
-VkShaderModule Resources::createShaderModule(std::vector<char> shaderBytes) const
+VkShaderModule Resources::createShaderModule(const std::string& spirvName) const
+{
+    // Shaders are compiled into the binary, only the ones hot reload recompiled are read from disk
+    {
+        std::lock_guard<std::mutex> lock(m_reloadedShaderMutex);
+        if(m_reloadedShaders.count(spirvName) != 0)
+        {
+            std::vector<char> shaderBytes = readShaderFile(m_shaderDirectory + spirvName);
+            return createShaderModule(reinterpret_cast<const uint32_t*>(shaderBytes.data()), shaderBytes.size());
+        }
+    }
+    for(const EmbeddedShader& shader: embeddedShaders)
+        if(spirvName == shader.name)
+            return createShaderModule(shader.code, shader.codeSize);
+    throw std::runtime_error("VK ERROR: No shader " + spirvName + " was compiled into the binary.");
+}
+
+VkShaderModule Resources::createShaderModule(const uint32_t* code, size_t codeSize) const
 {
     VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
     shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    shaderModuleCreateInfo.codeSize = shaderBytes.size();
-    shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(shaderBytes.data());
+    shaderModuleCreateInfo.codeSize = codeSize;
+    shaderModuleCreateInfo.pCode = code;
     
     VkShaderModule shaderModule;
     if(vkCreateShaderModule(m_device, &shaderModuleCreateInfo, VK_NULL_HANDLE, &shaderModule) != VK_SUCCESS)
@@ -1490,9 +2084,29 @@ VkShaderModule Resources::createShaderModule(std::vector<char> shaderBytes) cons
 
 void Resources::updateUniformBuffers()
 {
-    m_timeCurrentFrame = glfwGetTime();  // unit: seconds
+    // unit: seconds.A replay advances a simulated 60Hz clock, exactly two simulation steps per frame
+    m_timeCurrentFrame = m_deterministic ? m_timeLastFrame + 2.0 * m_simulationTimeStep : glfwGetTime();
     double deltaTime = m_timeCurrentFrame - m_timeLastFrame;
 
+    // The particles drawn this frame were stepped during the last one, so is the blend factor that goes with them
+    m_particles->updateUniformBuffers(m_currentFrameIndex, m_interpolationAlpha);
+
+    // Consume the elapsed time in fixed simulation steps, the remainder is carried over to the next frame
+    m_simulationSubstepCount = 0;
+    if(m_mouseLeftButtonDown)
+    {
+        m_simulationAccumulator += deltaTime;
+        while(m_simulationAccumulator >= m_simulationTimeStep && m_simulationSubstepCount < m_maxSimulationSubsteps)
+        {
+            m_simulationAccumulator -= m_simulationTimeStep;
+            ++m_simulationSubstepCount;
+        }
+        if(m_simulationAccumulator >= m_simulationTimeStep)
+            m_simulationAccumulator = std::fmod(m_simulationAccumulator, m_simulationTimeStep);
+    }
+    // How far we are between the last two simulated states
+    m_interpolationAlpha = static_cast<float>(m_simulationAccumulator / m_simulationTimeStep);
+
     // update draw shader ubo
     UBOProjectionMatrices uboProjectionMatrices;
     uboProjectionMatrices.model = glm::rotate(glm::mat4(1.f), glm::radians(90.f) * (float)m_timeCurrentFrame * 0.2f, glm::vec3(0.f, 0.f, 1.f));
@@ -1504,8 +2118,22 @@ void Resources::updateUniformBuffers()
     
     memcpy(m_uniformBuffersMapped[m_currentFrameIndex], &uboProjectionMatrices, sizeof(UBOProjectionMatrices));
 
-    // update particle shader ubo
-    m_particles->updateUniformBuffers(m_currentFrameIndex, deltaTime);
+    // Objects are laid out on a grid around the origin, every one but the first spins on its own
+    uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(m_objectCount))));
+    float spacing = 2.f / gridSize;
+    for(uint32_t object = 0; object < m_objectCount; ++object)
+    {
+        glm::vec3 offset = glm::vec3((object % gridSize) - (gridSize - 1) * 0.5f, (object / gridSize) - (gridSize - 1) * 0.5f, 0.f) * spacing;
+        glm::mat4 transform = glm::translate(glm::mat4(1.f), offset);
+        transform = glm::rotate(transform, glm::radians(30.f) * (float)m_timeCurrentFrame * (object % 4), glm::vec3(0.f, 0.f, 1.f));
+        m_objectTransforms[object] = glm::scale(transform, glm::vec3(1.f / gridSize));
+    }
+    if(!m_perDrawPushConstants)
+    {
+        uint8_t* drawData = static_cast<uint8_t*>(m_drawDataRingMapped) + static_cast<size_t>(m_drawDataStride) * m_objectCount * m_currentFrameIndex;
+        for(uint32_t object = 0; object < m_objectCount; ++object)
+            memcpy(drawData + static_cast<size_t>(m_drawDataStride) * object, &m_objectTransforms[object], sizeof(UBODrawData));
+    }
 
     m_timeLastFrame = m_timeCurrentFrame;
 }
@@ -1521,73 +2149,354 @@ void Resources::recordDrawCommandBuffer(VkCommandBuffer commandBuffer, uint32_t
     if(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS)
         throw std::runtime_error("VK ERROR: Failed to begin recording the commandbuffer for drawing scene.");
 
-    // Record `begin renderpass` command
-    VkRenderPassBeginInfo renderpassBeginInfo = {};
-    renderpassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderpassBeginInfo.renderPass = m_renderPass;
-    renderpassBeginInfo.framebuffer = m_swapChainFrameBuffers[imageIndex];
-    renderpassBeginInfo.renderArea.offset = {0, 0};
-    renderpassBeginInfo.renderArea.extent = m_swapChainImageExtent;
-    VkClearValue colorAttachmentClearValue = {.color = {.float32 = {0.f, 0.f, 0.f, 1.f}}};
-    VkClearValue depthAttachmentClearValue = {.depthStencil = {.depth = 1.f, .stencil = 0}};
-    VkClearValue clearValues[2] = {colorAttachmentClearValue, depthAttachmentClearValue};
-    renderpassBeginInfo.clearValueCount = 2;
-    renderpassBeginInfo.pClearValues = clearValues;
-    vkCmdBeginRenderPass(commandBuffer, &renderpassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-    // Record `bind to pipeline` command, then the command buffer will use the renderpass specified in that pipeline
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicPipeline);
+    if(m_timestampQueryPool != VK_NULL_HANDLE)
+    {
+        vkCmdResetQueryPool(commandBuffer, m_timestampQueryPool, 4 * m_currentFrameIndex + 2, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampQueryPool, 4 * m_currentFrameIndex + 2);
+    }
+
+    // Take over the particle SSBO the compute queue family released
+    if(m_particleAcquirePending[m_currentFrameIndex])
+    {
+        m_particles->cmdAcquireParticles(commandBuffer, m_currentFrameIndex);
+        m_particleAcquirePending[m_currentFrameIndex] = false;
+    }
+
+    cmdRenderFrameGraph(commandBuffer, imageIndex);
+
+    if(m_timestampQueryPool != VK_NULL_HANDLE)
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampQueryPool, 4 * m_currentFrameIndex + 3);
+
+    // Finally, end recording command buffer
+    if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to end recording the commandbuffer for drawing scene.");
+}
+
+void Resources::cmdRenderFrameGraph(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+    m_renderGraph->reset();
+
+    // The acquire semaphore is waited on at the color attachment output stage, nothing of the old contents is kept
+    RenderGraph::ResourceHandle swapChainImage = m_renderGraph->importImage("swapchain", m_swapChainImages[imageIndex], 
+        m_swapChainImageViews[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT, m_swapChainImageExtent, VK_IMAGE_LAYOUT_UNDEFINED, 
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    VkImageAspectFlags depthAspect = m_depthStencilImageFormat == VK_FORMAT_D32_SFLOAT ? 
+        VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    RenderGraph::ResourceHandle depthImage = m_renderGraph->createImage("depth", {m_depthStencilImageFormat, m_attachmentExtent, 
+        m_MSAASampleCount, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthAspect});
+
+    RenderGraph::Pass& scenePass = m_renderGraph->addPass("scene", [this, imageIndex](VkCommandBuffer commandBuffer)
+    {
+        // Until the pipelines are compiled the frame shows nothing but the clear color
+        if(m_pipelinesReady && m_recordThreadPool != VK_NULL_HANDLE)
+        {
+            std::vector<VkCommandBuffer> secondaryCommandBuffers = recordSecondaryCommandBuffers(imageIndex);
+            vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
+        }
+        else if(m_pipelinesReady)
+        {
+            if(m_depthPrepass)
+                cmdDrawScene(commandBuffer, 0, sceneDrawCount(), true);
+            cmdDrawScene(commandBuffer, 0, sceneDrawCount());
+
+            // Record `draw particles` command
+            m_particles->cmdDrawParticles(commandBuffer, m_currentFrameIndex);
+        }
+    });
+    // With dynamic resolution the scene lands in an offscreen target first
+    RenderGraph::ResourceHandle sceneColorImage = swapChainImage;
+    if(m_targetFrameTime > 0.f)
+        sceneColorImage = m_renderGraph->createImage("scene color", {m_swapChainImageFormat, m_attachmentExtent, VK_SAMPLE_COUNT_1_BIT,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT});
+
+    // Multisampled color is resolved into the scene color and never stored, single sampled color goes there directly
+    VkClearColorValue clearColor = {.float32 = {0.f, 0.f, 0.f, 1.f}};
+    if(m_MSAASampleCount != VK_SAMPLE_COUNT_1_BIT)
+    {
+        RenderGraph::ResourceHandle colorImage = m_renderGraph->createImage("msaa color", {m_swapChainImageFormat, m_attachmentExtent, 
+            m_MSAASampleCount, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT});
+        scenePass.color(colorImage, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_DONT_CARE, clearColor, sceneColorImage);
+    }
+    else
+        scenePass.color(sceneColorImage, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, clearColor);
+    scenePass.depth(depthImage, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_DONT_CARE)
+        .renderArea(m_renderExtent)
+        .renderingFlags(m_recordThreadPool != VK_NULL_HANDLE ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0u);
+
+    // Bilinear upscale of the rendered area to the whole swapchain image
+    if(sceneColorImage != swapChainImage)
+    {
+        m_renderGraph->addPass("upscale", [this, sceneColorImage, swapChainImage, renderExtent = m_renderExtent](VkCommandBuffer commandBuffer)
+        {
+            VkImageBlit imageBlit = {
+                .srcSubresource = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = 0,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1
+                },
+                .srcOffsets = {{0, 0, 0}, {static_cast<int32_t>(renderExtent.width), static_cast<int32_t>(renderExtent.height), 1}},
+                .dstSubresource = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = 0,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1
+                },
+                .dstOffsets = {{0, 0, 0}, {static_cast<int32_t>(m_swapChainImageExtent.width), static_cast<int32_t>(m_swapChainImageExtent.height), 1}}
+            };
+            vkCmdBlitImage(commandBuffer, m_renderGraph->getImage(sceneColorImage), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 
+                m_renderGraph->getImage(swapChainImage), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+        }).read(sceneColorImage, RenderGraphAccess::TransferSrc).write(swapChainImage, RenderGraphAccess::TransferDst);
+    }
+
+    // Read back the last frame of a replay
+    if(m_frameLimit != 0 && m_frameCount + 1 == m_frameLimit && (!m_capturePath.empty() || !m_goldenImagePath.empty()))
+    {
+        m_renderGraph->addPass("capture", [this, imageIndex](VkCommandBuffer commandBuffer)
+        {
+            cmdCaptureSwapChainImage(commandBuffer, imageIndex);
+        }).read(swapChainImage, RenderGraphAccess::TransferSrc).sideEffect();
+    }
+
+    m_renderGraph->compile();
+    m_renderGraph->execute(commandBuffer);
+}
+
+void Resources::cmdDrawScene(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount, bool depthOnly) const
+{
+    // Record `bind to pipeline` command, the pre-pass pipeline only writes depth
+    VkPipelineLayout graphicPipelineLayout = depthOnly ? m_depthPrepassPipelineLayout : m_graphicPipelineLayout;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthOnly ? m_depthPrepassPipeline : m_graphicPipeline);
     
     // Record `bind vertex&index buffer` command
     m_model->cmdBindBuffers(commandBuffer);
 
-    // Record `bind descriptor set` commmand
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicPipelineLayout, 0, 1, 
-        &m_graphicDescriptorSets[m_currentFrameIndex], 0, VK_NULL_HANDLE);
+    // Record `bind descriptor set` commmand. Set 1 holds every texture, materials pick theirs by index.
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicPipelineLayout, 1, 1, 
+        &m_bindlessDescriptorSet, 0, VK_NULL_HANDLE);
+    uint32_t textureIndex = m_model->textureIndex();
+    vkCmdPushConstants(commandBuffer, graphicPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::mat4), sizeof(uint32_t), &textureIndex);
 
     // Record `set dynamic state` command(In our case, viewport state and scissor state).
     VkViewport viewPort = {};
     viewPort.x = 0.f;
     viewPort.y = 0.f;
-    viewPort.width = m_swapChainImageExtent.width;
-    viewPort.height = m_swapChainImageExtent.height;
+    viewPort.width = m_renderExtent.width;
+    viewPort.height = m_renderExtent.height;
     viewPort.minDepth = 0.f;
     viewPort.maxDepth = 1.f;
     vkCmdSetViewport(commandBuffer, 0, 1, &viewPort);
     VkRect2D scissor = {};
     scissor.offset = {0, 0};
-    scissor.extent = m_swapChainImageExtent;
+    scissor.extent = m_renderExtent;
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    // Record `draw` command
-    m_model->cmdDrawIndexed(commandBuffer);
+    // Record `draw` commands. Every object takes drawChunkCount() draws, only the per-draw data changes between objects.
+    uint32_t chunkCount = m_model->drawChunkCount();
+    uint32_t zeroOffset = 0;
+    if(m_perDrawPushConstants)
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicPipelineLayout, 0, 1, 
+            &m_graphicDescriptorSets[m_currentFrameIndex], 1, &zeroOffset);
+    for(uint32_t draw = firstDraw; draw < firstDraw + drawCount;)
+    {
+        uint32_t object = draw / chunkCount,
+            firstChunk = draw % chunkCount,
+            objectChunkCount = std::min(chunkCount - firstChunk, firstDraw + drawCount - draw);
+        if(m_perDrawPushConstants)
+            vkCmdPushConstants(commandBuffer, graphicPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &m_objectTransforms[object]);
+        else
+        {
+            // Rebinding the same set with another dynamic offset, no descriptor set is written or allocated
+            uint32_t dynamicOffset = m_drawDataStride * object;
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicPipelineLayout, 0, 1, 
+                &m_graphicDescriptorSets[m_currentFrameIndex], 1, &dynamicOffset);
+        }
+        m_model->cmdDrawIndexed(commandBuffer, firstChunk, objectChunkCount);
+        draw += objectChunkCount;
+    }
+}
+
+std::vector<VkCommandBuffer> Resources::recordSecondaryCommandBuffers(uint32_t imageIndex)
+{
+    // Command pools of this frame index are no longer in use by the GPU, recycle all their command buffers at once
+    for(RecordContext& recordContext: m_recordContexts[m_currentFrameIndex])
+    {
+        vkResetCommandPool(m_device, recordContext.commandPool, 0);
+        recordContext.usedCount = 0;
+    }
 
-    // Record `draw particles` command
-    m_particles->cmdDrawParticles(commandBuffer, m_currentFrameIndex);
-    
-    // Record `end renderpass` command
-    vkCmdEndRenderPass(commandBuffer);
+    // One job per worker draws a range of scene chunks, one more draws the particles. The primary command buffer 
+    // executes them in job order, so the result does not depend on which worker ran which job. With the depth 
+    // pre-pass another set of jobs lays down depth for all chunks ahead of them.
+    uint32_t sceneJobCount = m_recordThreadPool->threadCount(),
+        prepassJobCount = m_depthPrepass ? sceneJobCount : 0;
+    std::vector<VkCommandBuffer> secondaryCommandBuffers(prepassJobCount + sceneJobCount + 1);
+    VkCommandBufferInheritanceRenderingInfoKHR inheritanceRenderingInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR,
+        .pNext = VK_NULL_HANDLE,
+        .flags = 0,
+        .viewMask = 0,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &m_swapChainImageFormat,
+        .depthAttachmentFormat = m_depthStencilImageFormat,
+        .stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+        .rasterizationSamples = m_MSAASampleCount
+    };
+    VkCommandBufferInheritanceInfo inheritanceInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext = &inheritanceRenderingInfo,
+        .renderPass = VK_NULL_HANDLE,
+        .subpass = 0,
+        .framebuffer = VK_NULL_HANDLE,
+        .occlusionQueryEnable = VK_FALSE,
+        .queryFlags = 0,
+        .pipelineStatistics = 0
+    };
+    auto recordJob = [this, &secondaryCommandBuffers, &inheritanceInfo](uint32_t jobIndex, std::function<void(VkCommandBuffer)> record)
+    {
+        return [this, &secondaryCommandBuffers, &inheritanceInfo, jobIndex, record](uint32_t threadIndex)
+        {
+            VkCommandBuffer commandBuffer = acquireSecondaryCommandBuffer(m_recordContexts[m_currentFrameIndex][threadIndex]);
+            VkCommandBufferBeginInfo beginInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .pNext = VK_NULL_HANDLE,
+                .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+                .pInheritanceInfo = &inheritanceInfo
+            };
+            if(vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+                throw std::runtime_error("VK ERROR: Failed to begin recording secondary command buffer.");
+            record(commandBuffer);
+            if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+                throw std::runtime_error("VK ERROR: Failed to end recording secondary command buffer.");
+            secondaryCommandBuffers[jobIndex] = commandBuffer;
+        };
+    };
 
-    // Finally, end recording command buffer
+    uint32_t drawCount = sceneDrawCount();
+    for(uint32_t job = 0; job < prepassJobCount + sceneJobCount; ++job)
+    {
+        bool depthOnly = job < prepassJobCount;
+        uint32_t sceneJob = depthOnly ? job : job - prepassJobCount;
+        uint32_t firstDraw = static_cast<uint64_t>(sceneJob) * drawCount / sceneJobCount,
+            lastDraw = static_cast<uint64_t>(sceneJob + 1) * drawCount / sceneJobCount;
+        m_recordThreadPool->enqueue(recordJob(job, [this, firstDraw, lastDraw, depthOnly](VkCommandBuffer commandBuffer)
+        {
+            cmdDrawScene(commandBuffer, firstDraw, lastDraw - firstDraw, depthOnly);
+        }));
+    }
+    m_recordThreadPool->enqueue(recordJob(prepassJobCount + sceneJobCount, [this](VkCommandBuffer commandBuffer)
+    {
+        m_particles->cmdDrawParticles(commandBuffer, m_currentFrameIndex);
+    }));
+    m_recordThreadPool->wait();
+    return secondaryCommandBuffers;
+}
+
+VkCommandBuffer Resources::acquireSecondaryCommandBuffer(RecordContext& recordContext) const
+{
+    if(recordContext.usedCount == recordContext.commandBuffers.size())
+    {
+        VkCommandBufferAllocateInfo allocateInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .pNext = VK_NULL_HANDLE,
+            .commandPool = recordContext.commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = 1
+        };
+        VkCommandBuffer commandBuffer;
+        if(vkAllocateCommandBuffers(m_device, &allocateInfo, &commandBuffer) != VK_SUCCESS)
+            throw std::runtime_error("VK ERROR: Failed to allocate secondary command buffer.");
+        recordContext.commandBuffers.push_back(commandBuffer);
+    }
+    return recordContext.commandBuffers[recordContext.usedCount++];
+}
+
+void Resources::reportRecordingTime() const
+{
+    if(m_recordSampleCount == 0)
+        return;
+    std::cout << "VK INFO: Recording draw commands took " << m_recordTimeTotal / m_recordSampleCount << "ms per frame on average ("
+        << (m_recordThreadPool != VK_NULL_HANDLE ? m_recordThreadPool->threadCount() : 0) << " recording threads, " 
+        << sceneDrawCount() << " scene draws";
+    if(m_cacheDrawCommands)
+        std::cout << ", cached command buffers re-recorded " << m_drawCommandRecordCount << " of " << m_recordSampleCount << " frames";
+    std::cout << ").\n";
+}
+
+uint32_t Resources::sceneDrawCount() const
+{
+    return m_objectCount * m_model->drawChunkCount();
+}
+
+void Resources::reportDrawThroughput() const
+{
+    if(m_drawBenchmarkFrameCount < 2)
+        return;
+    double seconds = std::chrono::duration<double>(m_drawBenchmarkEnd - m_drawBenchmarkBegin).count();
+    double draws = static_cast<double>(sceneDrawCount()) * (m_drawBenchmarkFrameCount - 1);
+    std::cout << "VK INFO: Drew " << m_objectCount << " objects in " << sceneDrawCount() << " draws per frame with per-draw data in " 
+        << (m_perDrawPushConstants ? "push constants" : "a dynamic uniform buffer ring") << ", " 
+        << static_cast<uint64_t>(draws / seconds) << " draws/s over " << m_drawBenchmarkFrameCount - 1 << " frames.\n";
+}
+
+VkCommandBuffer Resources::cachedDrawCommandBuffer(uint32_t imageIndex, bool& needsRecording)
+{
+    // Everything recorded from this frame index's pool has finished executing, so a stale cache is thrown away by 
+    // resetting the pool as a whole
+    DrawCommandCache& cache = m_drawCommandCaches[m_currentFrameIndex];
+    if(cache.generation != m_drawCommandGeneration || cache.commandBuffers.size() != m_swapChainImages.size())
+    {
+        vkResetCommandPool(m_device, cache.commandPool, 0);
+        if(cache.commandBuffers.size() != m_swapChainImages.size())
+        {
+            if(!cache.commandBuffers.empty())
+                vkFreeCommandBuffers(m_device, cache.commandPool, static_cast<uint32_t>(cache.commandBuffers.size()), cache.commandBuffers.data());
+            cache.commandBuffers.resize(m_swapChainImages.size());
+            VkCommandBufferAllocateInfo allocateInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .pNext = VK_NULL_HANDLE,
+                .commandPool = cache.commandPool,
+                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                .commandBufferCount = static_cast<uint32_t>(cache.commandBuffers.size())
+            };
+            if(vkAllocateCommandBuffers(m_device, &allocateInfo, cache.commandBuffers.data()) != VK_SUCCESS)
+                throw std::runtime_error("VK ERROR: Failed to allocate cached draw command buffers.");
+        }
+        cache.recorded.assign(cache.commandBuffers.size(), false);
+        cache.generation = m_drawCommandGeneration;
+    }
+    needsRecording = !cache.recorded[imageIndex];
+    cache.recorded[imageIndex] = true;
+    return cache.commandBuffers[imageIndex];
+}
+
+void Resources::recordParticleAcquire(VkCommandBuffer commandBuffer)
+{
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = VK_NULL_HANDLE
+    };
+    if(vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to begin recording particle acquire command buffer.");
+    m_particles->cmdAcquireParticles(commandBuffer, m_currentFrameIndex);
+    m_particleAcquirePending[m_currentFrameIndex] = false;
     if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
-        throw std::runtime_error("VK ERROR: Failed to end recording the commandbuffer for drawing scene.");
+        throw std::runtime_error("VK ERROR: Failed to end recording particle acquire command buffer.");
 }
 
 void Resources::cleanUpSwapChain()
 {
-    for(VkFramebuffer framebuffer: m_swapChainFrameBuffers)
-        vkDestroyFramebuffer(m_device, framebuffer, VK_NULL_HANDLE);
+    for(std::function<void()>& destroy: m_retiredSwapChains)
+        destroy();
+    m_retiredSwapChains.clear();
     for(VkImageView imageView: m_swapChainImageViews)
         vkDestroyImageView(m_device, imageView, VK_NULL_HANDLE);
     vkDestroySwapchainKHR(m_device, m_vkSwapChain, VK_NULL_HANDLE);
     
-    vkDestroyImageView(m_device, m_depthStencilImageView, VK_NULL_HANDLE);
-    vkDestroyImage(m_device, m_depthStencilImage, VK_NULL_HANDLE);
-    vkFreeMemory(m_device, m_depthStencilImageMemory, VK_NULL_HANDLE);
-
-    vkDestroyImageView(m_device, m_colorMSAAImageView, VK_NULL_HANDLE);
-    vkDestroyImage(m_device, m_colorMSAAImage, VK_NULL_HANDLE);
-    vkFreeMemory(m_device, m_colorMSAAImageMemory, VK_NULL_HANDLE);
+    m_renderGraph->cleanUp();
+    delete m_renderGraph;
 }
 
 void Resources::recreateSwapChain()
@@ -1600,14 +2509,233 @@ void Resources::recreateSwapChain()
         glfwGetFramebufferSize(m_window, &width, &height);
     }
 
-    vkDeviceWaitIdle(m_device);
-    cleanUpSwapChain();
-
+    // Frames still in flight keep rendering to the old swapchain and the presentation engine may still be showing its
+    // images. It's destroyed once an image has been acquired from a newer swapchain, see drawFrame.
+    VkSwapchainKHR oldSwapChain = m_vkSwapChain;
+    std::vector<VkImageView> oldImageViews = std::move(m_swapChainImageViews);
     createSwapChain();
+    m_retiredSwapChains.push_back([this, oldSwapChain, oldImageViews]()
+    {
+        for(VkImageView imageView: oldImageViews)
+            vkDestroyImageView(m_device, imageView, VK_NULL_HANDLE);
+        vkDestroySwapchainKHR(m_device, oldSwapChain, VK_NULL_HANDLE);
+    });
     createSwapChainImageViews();
-    createColorResources();
-    createDepthResources();
-    createSwapChainFrameBuffers();
+
+    // MSAA and depth images only have to be at least as large as the framebuffer, keep them when the window shrinks.
+    // A larger declaration makes the render graph retire and reallocate them on the next recording.
+    if(m_swapChainImageExtent.width > m_attachmentExtent.width || m_swapChainImageExtent.height > m_attachmentExtent.height)
+        m_attachmentExtent = m_swapChainImageExtent;
+    updateRenderExtent();
+    invalidateDrawCommands();
+}
+
+void Resources::deferDestruction(std::function<void()> destroy) const
+{
+    // Retired while building frame m_frameSerial + 1. Every earlier frame may still use the resource, and uploads 
+    // recorded in between only complete along with the graphic work of that frame.
+    m_deferredDestructions.push_back({m_frameSerial + 1, std::move(destroy)});
+}
+
+void Resources::retireBuffer(VkBuffer buffer, VkDeviceMemory memory) const
+{
+    deferDestruction([this, buffer, memory]()
+    {
+        vkDestroyBuffer(m_device, buffer, VK_NULL_HANDLE);
+        vkFreeMemory(m_device, memory, VK_NULL_HANDLE);
+    });
+}
+
+void Resources::retireTexture(const Texture& texture) const
+{
+    deferDestruction([this, texture]()
+    {
+        cleanUpTexture(texture);
+    });
+}
+
+void Resources::reloadModel()
+{
+    m_model->loadModel(m_modelPath.c_str(), m_texturePath.c_str());
+    // The new texture got a new bindless index, which recorded draws push as a constant
+    invalidateDrawCommands();
+}
+
+void Resources::reloadPipelines()
+{
+    // Frames keep drawing with the current pipelines, applyPipelineSwaps retires them once the new set is complete. 
+    // A set for another MSAA level that is still compiling is rebuilt as it is.
+    createPipeline(m_pipelineManager->setPending() ? m_pipelineManager->setKey() : currentPipelineKey());
+}
+
+void Resources::pollShaderSources()
+{
+    // Only one rebuild at a time, edits made meanwhile are picked up by the next poll
+    double currentTime = glfwGetTime();
+    if(currentTime - m_lastShaderPoll < 0.25 || m_shaderRebuildPending)
+        return;
+    m_lastShaderPoll = currentTime;
+
+    // Every .vert, .frag and .comp in the shader directory is watched. "name.stage" compiles to "name_stage.spv" like 
+    // the build names it, and feeds the pipelines that load that SPIR-V. Sources don't have to be shipped at all.
+    std::vector<ShaderSource> changedShaders;
+    std::error_code error;
+    for(const std::filesystem::directory_entry& entry: std::filesystem::directory_iterator(m_shaderDirectory, error))
+    {
+        std::string extension = entry.path().extension().string();
+        if(extension != ".vert" && extension != ".frag" && extension != ".comp")
+            continue;
+        std::filesystem::file_time_type writeTime = entry.last_write_time(error);
+        if(error)
+            continue;
+        std::string source = entry.path().filename().string();
+        auto iter = m_shaderWriteTimes.find(source);
+        if(iter == m_shaderWriteTimes.end())
+            m_shaderWriteTimes[source] = writeTime;
+        else if(iter->second != writeTime)
+        {
+            iter->second = writeTime;
+            ShaderSource shader = {source, entry.path().stem().string() + "_" + extension.substr(1) + ".spv", {}};
+            for(ShaderPipeline pipeline: {ShaderPipeline::Scene, ShaderPipeline::DepthPrepass, 
+                ShaderPipeline::ParticleGraphic, ShaderPipeline::ParticleCompute})
+            {
+                std::vector<std::string> shaders = pipelineShaders(pipeline);
+                if(std::find(shaders.begin(), shaders.end(), shader.spirv) != shaders.end())
+                    shader.pipelines.push_back(pipeline);
+            }
+            changedShaders.push_back(shader);
+        }
+    }
+    if(changedShaders.empty())
+        return;
+    // The render target state is read here, the worker builds against this snapshot
+    PipelineKey key = currentPipelineKey();
+    m_shaderRebuildPending = true;
+    m_pipelineManager->enqueue([this, changedShaders, key]()
+    {
+        rebuildShaders(changedShaders, key);
+        m_shaderRebuildPending = false;
+    });
+}
+
+void Resources::rebuildShaders(const std::vector<ShaderSource>& changedShaders, const PipelineKey& key)
+{
+    // Runs on a pipeline worker. A shader that fails to compile keeps its current SPIR-V and pipeline.
+    std::set<ShaderPipeline> affectedPipelines;
+    for(const ShaderSource& shader: changedShaders)
+    {
+        std::string spirvPath = m_shaderDirectory + shader.spirv,
+            temporaryPath = spirvPath + ".tmp";
+        std::string command = "\"" + m_glslcPath + "\" \"" + m_shaderDirectory + shader.source + "\" -o \"" + temporaryPath + "\"";
+#ifdef _WIN32
+        command = "\"" + command + "\"";  // cmd.exe strips the outer quotes
+#endif
+        std::cout << "VK INFO: Recompiling " << shader.source << ".\n";
+        if(std::system(command.c_str()) != 0)
+        {
+            std::cout << "VK INFO: " << shader.source << " failed to compile, keeping the current pipeline.\n";
+            continue;
+        }
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, spirvPath, error);
+        if(error)
+        {
+            std::cout << "VK INFO: Failed to replace " << spirvPath << ", " << error.message() << ".\n";
+            continue;
+        }
+        if(shader.pipelines.empty())
+            std::cout << "VK INFO: No pipeline uses " << shader.spirv << " yet.\n";
+        affectedPipelines.insert(shader.pipelines.begin(), shader.pipelines.end());
+        std::lock_guard<std::mutex> lock(m_reloadedShaderMutex);
+        m_reloadedShaders.insert(shader.spirv);
+    }
+
+    for(ShaderPipeline pipeline: affectedPipelines)
+    {
+        if(pipeline == ShaderPipeline::DepthPrepass && !m_depthPrepass)
+            continue;
+        m_pipelineManager->rebuild(pipeline, key);
+    }
+}
+
+void Resources::applyPipelineSwaps()
+{
+    // Pipelines of a set wait for the rest of it, so the frame never mixes old and new ones. A set completing for 
+    // another sample count switches the MSAA level along with it, the render graph follows on this frame's recording.
+    // A replay has to render the exact same frames every run, it waits for the set being compiled.
+    std::vector<PipelineSwap> installs, rebuilds;
+    bool setComplete = m_pipelineManager->collect(m_deterministic, installs, rebuilds);
+    VkSampleCountFlagBits previousSampleCount = m_MSAASampleCount;
+    if(setComplete)
+        m_MSAASampleCount = installs.front().key.sampleCount;
+
+    // Single hot reloaded pipelines go in right away, unless they were built for render targets no longer in use
+    uint32_t rebuildCount = 0;
+    for(const PipelineSwap& pipelineSwap: rebuilds)
+    {
+        if(pipelineSwap.key == currentPipelineKey())
+        {
+            installs.push_back(pipelineSwap);
+            ++rebuildCount;
+        }
+        else
+            m_pipelineManager->destroy(pipelineSwap);
+    }
+    if(rebuildCount < rebuilds.size())
+        std::cout << "VK INFO: Dropped " << rebuilds.size() - rebuildCount << " rebuilt pipelines of a previous MSAA level.\n";
+    if(installs.empty())
+        return;
+
+    for(const PipelineSwap& pipelineSwap: installs)
+    {
+        // Frames in flight still use the replaced pipelines
+        if(pipelineSwap.pipeline == ShaderPipeline::Scene)
+        {
+            deferDestruction([this, pipeline = m_graphicPipeline, pipelineLayout = m_graphicPipelineLayout]()
+            {
+                vkDestroyPipeline(m_device, pipeline, VK_NULL_HANDLE);
+                vkDestroyPipelineLayout(m_device, pipelineLayout, VK_NULL_HANDLE);
+            });
+            m_graphicPipeline = pipelineSwap.handle;
+            m_graphicPipelineLayout = pipelineSwap.layout;
+        }
+        else if(pipelineSwap.pipeline == ShaderPipeline::DepthPrepass)
+        {
+            deferDestruction([this, pipeline = m_depthPrepassPipeline, pipelineLayout = m_depthPrepassPipelineLayout]()
+            {
+                vkDestroyPipeline(m_device, pipeline, VK_NULL_HANDLE);
+                vkDestroyPipelineLayout(m_device, pipelineLayout, VK_NULL_HANDLE);
+            });
+            m_depthPrepassPipeline = pipelineSwap.handle;
+            m_depthPrepassPipelineLayout = pipelineSwap.layout;
+        }
+        else if(pipelineSwap.pipeline == ShaderPipeline::ParticleGraphic)
+            deferDestruction(m_particles->replaceGraphicPipeline(pipelineSwap.handle, pipelineSwap.layout));
+        else
+            deferDestruction(m_particles->replaceComputePipeline(pipelineSwap.handle, pipelineSwap.layout));
+    }
+    invalidateDrawCommands();
+
+    if(setComplete && !m_pipelinesReady)
+        std::cout << "VK INFO: Pipelines ready after " << m_pipelineManager->setCompileTime() << "ms, " 
+            << m_frameCount << " frames were drawn without them.\n";
+    else if(setComplete)
+        std::cout << "VK INFO: Swapped in a new pipeline set after " << m_pipelineManager->setCompileTime() 
+            << "ms, the previous one kept drawing meanwhile.\n";
+    if(m_MSAASampleCount != previousSampleCount)
+        std::cout << "VK INFO: MSAA set to " << m_MSAASampleCount << "x.\n";
+    if(rebuildCount != 0)
+        std::cout << "VK INFO: Swapped in " << rebuildCount << " rebuilt pipelines.\n";
+    m_pipelinesReady = m_pipelinesReady || setComplete;
+}
+
+void Resources::runDeferredDestructions(uint64_t completedSerial)
+{
+    while(!m_deferredDestructions.empty() && m_deferredDestructions.front().first <= completedSerial)
+    {
+        m_deferredDestructions.front().second();
+        m_deferredDestructions.pop_front();
+    }
 }
 
 void Resources::createModelVertexBuffer(const std::vector<Vertex>& vertices, VkBuffer& vertexBuffer, VkDeviceMemory& vertexBufferMemory) const
@@ -1629,8 +2757,7 @@ void Resources::createModelVertexBuffer(const std::vector<Vertex>& vertices, VkB
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
     copyBuffer2Buffer(stagingBuffer, vertexBuffer, bufferSize);
 
-    vkDestroyBuffer(m_device, stagingBuffer, VK_NULL_HANDLE);
-    vkFreeMemory(m_device, stagingBufferMemory, VK_NULL_HANDLE);
+    retireBuffer(stagingBuffer, stagingBufferMemory);
 }
 
 void Resources::createModelIndexBuffer(const std::vector<uint32_t>& indices, VkBuffer& indexBuffer, VkDeviceMemory& indexBufferMemory) const
@@ -1653,36 +2780,68 @@ void Resources::createModelIndexBuffer(const std::vector<uint32_t>& indices, VkB
     
     copyBuffer2Buffer(stagingBuffer, indexBuffer, bufferSize);
     
-    vkDestroyBuffer(m_device, stagingBuffer, VK_NULL_HANDLE);
-    vkFreeMemory(m_device, stagingBufferMemory, VK_NULL_HANDLE);
+    retireBuffer(stagingBuffer, stagingBufferMemory);
 }
 
 void Resources::cleanUp()
 {
-    vkDestroyDescriptorPool(m_device, m_descriptorPool, VK_NULL_HANDLE);
+    // Let pending pipeline compilations finish before anything they use goes away
+    m_pipelineManager->cleanUp();
+    delete m_pipelineManager;
+
+    m_descriptorAllocator->cleanUp();
+    delete m_descriptorAllocator;
+    vkDestroyDescriptorPool(m_device, m_bindlessDescriptorPool, VK_NULL_HANDLE);
     
     for(uint32_t i = 0; i < m_maxInflightFrames; ++i)
     {
-        vkDestroyFence(m_device, m_graphicInFlightFences[i], VK_NULL_HANDLE);
-        vkDestroyFence(m_device, m_computeInFlightFences[i], VK_NULL_HANDLE);
         vkDestroySemaphore(m_device, m_acquireImageSemaphores[i], VK_NULL_HANDLE);
-        vkDestroySemaphore(m_device, m_computeCompleteSemaphores[i], VK_NULL_HANDLE);
         vkDestroySemaphore(m_device, m_drawSemaphores[i], VK_NULL_HANDLE);
 
         vkDestroyBuffer(m_device, m_uniformBuffers[i], VK_NULL_HANDLE);
         vkFreeMemory(m_device, m_uniformBufferMemories[i], VK_NULL_HANDLE);
     }
-    m_model->cleanUp(m_device);
+    vkDestroyBuffer(m_device, m_drawDataRing, VK_NULL_HANDLE);
+    vkFreeMemory(m_device, m_drawDataRingMemory, VK_NULL_HANDLE);
+    vkDestroySemaphore(m_device, m_graphicTimeline, VK_NULL_HANDLE);
+    vkDestroySemaphore(m_device, m_computeTimeline, VK_NULL_HANDLE);
+    if(m_timestampQueryPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(m_device, m_timestampQueryPool, VK_NULL_HANDLE);
+    if(m_captureBuffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(m_device, m_captureBuffer, VK_NULL_HANDLE);
+        vkFreeMemory(m_device, m_captureBufferMemory, VK_NULL_HANDLE);
+    }
+    m_model->cleanUp();
     m_particles->cleanUp(m_device, m_maxInflightFrames);
+    runDeferredDestructions(std::numeric_limits<uint64_t>::max());
 
     vkDestroyCommandPool(m_device, m_graphicCommandPool, VK_NULL_HANDLE);
     vkDestroyCommandPool(m_device, m_computeCommandPool, VK_NULL_HANDLE);
+    delete m_recordThreadPool;
+    m_textureLoader->cleanUp();
+    delete m_textureLoader;
+    for(const DrawCommandCache& cache: m_drawCommandCaches)
+        vkDestroyCommandPool(m_device, cache.commandPool, VK_NULL_HANDLE);
+    for(const std::vector<RecordContext>& frameRecordContexts: m_recordContexts)
+        for(const RecordContext& recordContext: frameRecordContexts)
+            vkDestroyCommandPool(m_device, recordContext.commandPool, VK_NULL_HANDLE);
     
-    writePipelineCacheData();
+    // Not worth leaking the device over, a failed write is only logged
+    try
+    {
+        writePipelineCacheData();
+    }
+    catch(const std::runtime_error& error)
+    {
+        std::cout << "VK INFO: Pipeline cache not saved, " << error.what() << "\n";
+    }
     vkDestroyPipelineCache(m_device, m_pipelineCache, VK_NULL_HANDLE);
     vkDestroyPipeline(m_device, m_graphicPipeline, VK_NULL_HANDLE);
-    vkDestroyRenderPass(m_device, m_renderPass, VK_NULL_HANDLE);
+    vkDestroyPipeline(m_device, m_depthPrepassPipeline, VK_NULL_HANDLE);
+    vkDestroyPipelineLayout(m_device, m_depthPrepassPipelineLayout, VK_NULL_HANDLE);
     vkDestroyDescriptorSetLayout(m_device, m_graphicDescriptorSetLayout, VK_NULL_HANDLE);
+    vkDestroyDescriptorSetLayout(m_device, m_bindlessDescriptorSetLayout, VK_NULL_HANDLE);
     vkDestroyPipelineLayout(m_device, m_graphicPipelineLayout, VK_NULL_HANDLE);
     cleanUpSwapChain();
     vkDestroyDevice(m_device, VK_NULL_HANDLE);
@@ -1694,52 +2853,49 @@ void Resources::cleanUp()
     glfwTerminate();
 }
 
+void Resources::createTextureLoader()
+{
+    uint32_t threadCount = m_textureThreadCount.value_or(std::max(1u, std::thread::hardware_concurrency()));
+    m_textureLoader = new TextureLoader(m_device, m_graphicQueueFamily, threadCount, 64 * 1024 * 1024);
+}
+
 void Resources::loadModel()
 {
-    m_model->loadModel("./model/viking_room.obj");
+    m_model->loadModel(m_modelPath.c_str(), m_texturePath.c_str());
+    m_model->setDrawChunkCount(m_drawChunkCount);
+
+    if(m_textureLoadTestCount == 0)
+        return;
+    // Stands in for a scene with many textures, the timing printed by the loader is what to compare across --texture-threads
+    std::vector<const char*> filenames(m_textureLoadTestCount, m_texturePath.c_str());
+    m_textureLoader->load(filenames, [this](std::vector<Texture>& textures)
+    {
+        for(const Texture& texture: textures)
+            cleanUpTexture(texture);
+    });
 }
 
 void Resources::createTexture(const char* filename, Texture& texture) const
 {
-    int imageWidth, imageHeight, imageChannels;
-    stbi_uc* data = stbi_load(filename, &imageWidth, &imageHeight, &imageChannels, 
-        STBI_rgb_alpha);
-    if(!data)
-        throw std::runtime_error("STBI ERROR: Failed to load image.");
-    texture.path = filename;
-
-    VkDeviceSize imageBufferSize = 4 * imageWidth * imageHeight;
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(imageBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer, stagingBufferMemory);
-
-    void* bufferData;
-    vkMapMemory(m_device, stagingBufferMemory, 0, imageBufferSize, 0, &bufferData);
-    memcpy(bufferData, data, imageBufferSize);
-    vkUnmapMemory(m_device, stagingBufferMemory);
-    stbi_image_free(data);
-
-    texture.mipLevels = glm::floor(glm::log2(static_cast<float_t>(glm::max(imageWidth, imageHeight)))) + 1;
-    createImage(imageWidth, imageHeight, 
-        VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, 
-        texture.mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.imageMemory);
-        
-    transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.image, texture.mipLevels);
-    
-    copyBuffer2Image(stagingBuffer, texture.image, static_cast<uint32_t>(imageWidth), 
-        static_cast<uint32_t>(imageHeight));
-    
-    generateMipmaps(texture.image, VK_FORMAT_R8G8B8A8_SRGB, imageWidth, imageHeight, texture.mipLevels);
-
-    vkDestroyBuffer(m_device, stagingBuffer, VK_NULL_HANDLE);
-    vkFreeMemory(m_device, stagingBufferMemory, VK_NULL_HANDLE);
-
-    createImageView(texture.imageView, texture.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+    m_textureLoader->load({filename}, [&texture](std::vector<Texture>& textures)
+    {
+        texture = textures[0];
+    });
+}
 
-    createSampler(texture.sampler, texture.mipLevels);
+bool Resources::isTextureFormatSupported(VkFormat format) const
+{
+    // Block compressed formats are only usable with their feature enabled, whatever the format properties say
+    if(format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK && !m_physicalDeviceFeature.textureCompressionBC)
+        return false;
+    if(format >= VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && format <= VK_FORMAT_EAC_R11G11_SNORM_BLOCK && !m_physicalDeviceFeature.textureCompressionETC2)
+        return false;
+    if(format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK && !m_physicalDeviceFeature.textureCompressionASTC_LDR)
+        return false;
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &formatProperties);
+    VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
 }
 
 void Resources::createSampler(VkSampler& sampler, uint32_t mipLevel) const
@@ -1770,15 +2926,49 @@ void Resources::mainLoop()
 {
     if(!m_complete)
         throw std::runtime_error("VK ERROR: Vulkan resources have not been intialized yet.");
-    while(!glfwWindowShouldClose(m_window))
+    m_timeLastFrame = m_deterministic ? 0.f : glfwGetTime();
+    if(m_deterministic)
+        m_mouseLeftButtonDown = VK_TRUE;  // Nobody is going to click during a replay, shoot right away
+
+    while(!glfwWindowShouldClose(m_window) && (m_frameLimit == 0 || m_frameCount < m_frameLimit))
     {
         glfwPollEvents();
+        m_inputSampleTime = glfwGetTime();
+        if(m_reloadRequested)
+        {
+            reloadModel();
+            reloadPipelines();
+            m_reloadRequested = VK_FALSE;
+        }
+        if(m_MSAASweepFrames != 0 && m_frameCount != 0 && m_frameCount % m_MSAASweepFrames == 0 && 
+            m_MSAASampleCount < chooseMSAASampleCount(8) && !m_pipelineManager->setPending())
+        {
+            m_requestedSampleCount = nextMSAASampleCount();
+            m_MSAAChangeRequested = VK_TRUE;
+        }
+        if(m_MSAAChangeRequested)
+        {
+            applyMSAASampleCount();
+            m_MSAAChangeRequested = VK_FALSE;
+        }
+        if(!m_deterministic)
+            pollShaderSources();
         drawFrame();
     }
     vkDeviceWaitIdle(m_device);
+
+    reportTimestamps();
+    reportMSAAFrameTimes();
+    reportDynamicResolution();
+    reportRecordingTime();
+    reportDrawThroughput();
+    collectInputLatency();
+    reportInputLatency();
+    if(m_captureBuffer != VK_NULL_HANDLE)
+        readCapturedImage();
 }
 
-void Resources::generateMipmaps(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels) const
+void Resources::cmdGenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels) const
 {
     // Assert that the image format supports linear
     VkFormatProperties formatProperties;
@@ -1786,7 +2976,6 @@ void Resources::generateMipmaps(VkImage image, VkFormat format, uint32_t width,
     if(!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
         throw std::runtime_error("VK ERROR: Image format does not support mipmap linear filtering, generating mipmaps is rejected.");
 
-    VkCommandBuffer genMipCommandBuffer = beginSingleTimeCommandBuffer();
     VkImageMemoryBarrier imageMemoryBarrier = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
         .pNext = VK_NULL_HANDLE,
@@ -1814,7 +3003,7 @@ void Resources::generateMipmaps(VkImage image, VkFormat format, uint32_t width,
         imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
         imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
         imageMemoryBarrier.subresourceRange.baseMipLevel = i - 1;
-        vkCmdPipelineBarrier(genMipCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 
             0,
             0, VK_NULL_HANDLE,
             0, VK_NULL_HANDLE,
@@ -1843,7 +3032,7 @@ void Resources::generateMipmaps(VkImage image, VkFormat format, uint32_t width,
                 {imageWidth > 1 ? static_cast<int32_t>(imageWidth / 2) : 1, imageHeight > 1 ? static_cast<int32_t>(imageHeight / 2) : 1, 1}
             }
         };
-        vkCmdBlitImage(genMipCommandBuffer, 
+        vkCmdBlitImage(commandBuffer, 
             image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 
             image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
             1, &imageBlit, VK_FILTER_LINEAR);
@@ -1854,7 +3043,7 @@ void Resources::generateMipmaps(VkImage image, VkFormat format, uint32_t width,
         imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
         imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         imageMemoryBarrier.subresourceRange.baseMipLevel = i - 1;
-        vkCmdPipelineBarrier(genMipCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
             0, 
             0, VK_NULL_HANDLE,
             0, VK_NULL_HANDLE, 
@@ -1870,13 +3059,11 @@ void Resources::generateMipmaps(VkImage image, VkFormat format, uint32_t width,
     imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
     imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     imageMemoryBarrier.subresourceRange.baseMipLevel = mipLevels - 1;
-    vkCmdPipelineBarrier(genMipCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
         0, 
         0, VK_NULL_HANDLE,
         0, VK_NULL_HANDLE, 
         1, &imageMemoryBarrier);
-    
-    endSingleTimeCommandBuffer(genMipCommandBuffer);
 }
 
 Resources* Resources::instance = VK_NULL_HANDLE;
@@ -1908,21 +3095,64 @@ VkSampleCountFlagBits Resources::getMSAASampleCount() const
     throw std::runtime_error("VK ERROR: Failed to get a valid MSAA sample count");
 }
 
-void Resources::createColorResources()
+VkSampleCountFlagBits Resources::chooseMSAASampleCount(uint32_t requestedSampleCount) const
+{
+    // The highest supported count not above the requested one
+    if(requestedSampleCount == 0)
+        return getMSAASampleCount();
+    VkSampleCountFlags sampleCountFlags = m_physicalDeviceProperties.limits.framebufferColorSampleCounts 
+        & m_physicalDeviceProperties.limits.framebufferDepthSampleCounts;
+    for(VkSampleCountFlagBits sampleCountFlagBit : std::vector<VkSampleCountFlagBits>({VK_SAMPLE_COUNT_8_BIT, 
+        VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_2_BIT}))
+    {
+        if(sampleCountFlagBit <= requestedSampleCount && (sampleCountFlags & sampleCountFlagBit))
+            return sampleCountFlagBit;
+    }
+    return VK_SAMPLE_COUNT_1_BIT;
+}
+
+uint32_t Resources::nextMSAASampleCount() const
 {
-    createImage(m_swapChainImageExtent.width, m_swapChainImageExtent.height, m_swapChainImageFormat, 
-        VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 1, m_MSAASampleCount, 
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_colorMSAAImage, m_colorMSAAImageMemory);
-    createImageView(m_colorMSAAImageView, m_colorMSAAImage, m_swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+    // Steps on from a level whose pipelines are still compiling
+    VkSampleCountFlagBits sampleCount = m_pipelineManager->setPending() ? m_pipelineManager->setKey().sampleCount : m_MSAASampleCount;
+    return sampleCount >= chooseMSAASampleCount(8) ? 1u : 2u * sampleCount;
+}
+
+void Resources::applyMSAASampleCount()
+{
+    PipelineKey key = currentPipelineKey();
+    key.sampleCount = chooseMSAASampleCount(m_requestedSampleCount);
+    if(key == (m_pipelineManager->setPending() ? m_pipelineManager->setKey() : currentPipelineKey()))
+        return;
+
+    // Pipelines for the new count compile in the background, from the pipeline cache once a run has used it. Frames 
+    // keep drawing at the current count until applyPipelineSwaps installs them and switches m_MSAASampleCount, the 
+    // render graph then sees the new attachment declarations and retires the old images.
+    createPipeline(key);
+    std::cout << "VK INFO: Switching MSAA to " << key.sampleCount << "x, drawing at " << m_MSAASampleCount << 
+        "x until its pipelines are ready.\n";
+}
+
+void Resources::reportMSAAFrameTimes() const
+{
+    if(m_MSAAFrameTimes.size() < 2)
+        return;
+    std::cout << "VK INFO: Drawing took";
+    for(const auto& [sampleCount, frameTime]: m_MSAAFrameTimes)
+        std::cout << " " << frameTime.first / frameTime.second << "ms at " << sampleCount << "x MSAA (" << frameTime.second << " frames)" 
+            << (sampleCount == m_MSAAFrameTimes.rbegin()->first ? "" : ",");
+    std::cout << " per frame on average.\n";
 }
 
 void Resources::createParticleSSBOs(std::vector<VkBuffer>& particleSSBOs, 
     std::vector<VkDeviceMemory>& particleSSBOMemories,
-    const std::vector<Particle>& particles) const
+    const std::vector<Particle>& particles,
+    uint32_t bufferCount,
+    bool computeQueueOwned) const
 {
     uint32_t bufferSize = m_particles->particleBufferSize();
-    particleSSBOs.resize(m_maxInflightFrames);
-    particleSSBOMemories.resize(m_maxInflightFrames);
+    particleSSBOs.resize(bufferCount);
+    particleSSBOMemories.resize(bufferCount);
 
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
@@ -1937,67 +3167,51 @@ void Resources::createParticleSSBOs(std::vector<VkBuffer>& particleSSBOs,
     memcpy(data, particles.data(), bufferSize);
     vkUnmapMemory(m_device, stagingBufferMemory);
 
-    for(uint32_t i = 0; i < m_maxInflightFrames; ++i)
+    for(uint32_t i = 0; i < bufferCount; ++i)
     {
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, particleSSBOs[i], particleSSBOMemories[i]);
 
-        copyBuffer2Buffer(stagingBuffer, particleSSBOs[i], bufferSize);
+        // Buffers only the compute queue touches are uploaded there, so they belong to its queue family from the start
+        copyBuffer2Buffer(stagingBuffer, particleSSBOs[i], bufferSize, computeQueueOwned);
     }
 
-    vkDestroyBuffer(m_device, stagingBuffer, VK_NULL_HANDLE);
-    vkFreeMemory(m_device, stagingBufferMemory, VK_NULL_HANDLE);
+    retireBuffer(stagingBuffer, stagingBufferMemory);
 }
 
 void Resources::allocateParticleDescriptorSets(std::vector<VkDescriptorSet>& computeDescriptorSets, 
     std::vector<VkDescriptorSet>& graphicDescriptorSets,
     const std::vector<VkBuffer>& particleUBOs, 
-    const std::vector<VkBuffer>& particleSSBOs,
+    const std::vector<VkBuffer>& simulationSSBOs,
     VkDescriptorSetLayout graphicDescriptorSetLayout,
     VkDescriptorSetLayout computeDescriptorSetLayout) const
 {
-    computeDescriptorSets.resize(m_maxInflightFrames);
+    // Two compute sets per frame, one for each ping-pong direction between the simulation SSBOs
+    uint32_t computeDescriptorSetCount = 2 * m_maxInflightFrames;
+    computeDescriptorSets.resize(computeDescriptorSetCount);
     graphicDescriptorSets.resize(m_maxInflightFrames);
-    std::vector<VkDescriptorSetLayout> computeDescriptorSetLayouts(m_maxInflightFrames, computeDescriptorSetLayout);
+    std::vector<VkDescriptorSetLayout> computeDescriptorSetLayouts(computeDescriptorSetCount, computeDescriptorSetLayout);
     std::vector<VkDescriptorSetLayout> graphicDescriptorSetLayouts(m_maxInflightFrames, graphicDescriptorSetLayout);
 
-    // Allocate computeDescriptorSets
-    VkDescriptorSetAllocateInfo computeDescriotorSetAllocateInfo = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-        .pNext = VK_NULL_HANDLE,
-        .descriptorPool = m_descriptorPool,
-        .descriptorSetCount = m_maxInflightFrames,
-        .pSetLayouts = computeDescriptorSetLayouts.data()
-    };
-    if(vkAllocateDescriptorSets(m_device, &computeDescriotorSetAllocateInfo, computeDescriptorSets.data()) != VK_SUCCESS)
-        throw std::runtime_error("VK ERROR: Failed to allocate desciptor set for particle compute pipeline.");
-    
-    // Allocate graphicDescriptorSets
-    VkDescriptorSetAllocateInfo graphicDescriptorSetAllocateInfo = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-        .pNext = VK_NULL_HANDLE,
-        .descriptorPool = m_descriptorPool,
-        .descriptorSetCount = m_maxInflightFrames,
-        .pSetLayouts = graphicDescriptorSetLayouts.data()
-    };
-    if(vkAllocateDescriptorSets(m_device, &graphicDescriptorSetAllocateInfo, graphicDescriptorSets.data()) != VK_SUCCESS)
-        throw std::runtime_error("VK ERROR: Failed to allocate desciptor set for particle graphic pipeline.");
+    // Allocate computeDescriptorSets and graphicDescriptorSets
+    m_descriptorAllocator->allocate(computeDescriptorSetLayouts, computeDescriptorSets);
+    m_descriptorAllocator->allocate(graphicDescriptorSetLayouts, graphicDescriptorSets);
 
-    // Write computeDescriptorSets
-    for(uint32_t i = 0; i < m_maxInflightFrames; ++i)
+    // Write computeDescriptorSets, set 2 * frame + n reads simulationSSBOs[n] and writes the other one
+    for(uint32_t i = 0; i < computeDescriptorSetCount; ++i)
     {
         VkDescriptorBufferInfo deltaTimeBufferInfo = {
-            .buffer = particleUBOs[i],
+            .buffer = particleUBOs[i / 2],
             .offset = 0,
             .range = sizeof(ParticleGroup::UBOParticle)
         };
         VkDescriptorBufferInfo pariticleReadBufferInfo = {
-            .buffer = particleSSBOs[(i - 1) % m_maxInflightFrames],
+            .buffer = simulationSSBOs[i % 2],
             .offset = 0,
             .range = m_particles->particleBufferSize()
         };
         VkDescriptorBufferInfo pariticleWriteBufferInfo = {
-            .buffer = particleSSBOs[i],
+            .buffer = simulationSSBOs[(i + 1) % 2],
             .offset = 0,
             .range = m_particles->particleBufferSize()
         };
@@ -2052,7 +3266,12 @@ void Resources::allocateParticleDescriptorSets(std::vector<VkDescriptorSet>& com
             .offset = 0,
             .range = sizeof(UBOProjectionMatrices)
         };
-        VkWriteDescriptorSet pWriteDescriptorSets[1] = {
+        VkDescriptorBufferInfo particleUBOInfo = {
+            .buffer = particleUBOs[i],
+            .offset = 0,
+            .range = sizeof(ParticleGroup::UBOParticle)
+        };
+        VkWriteDescriptorSet pWriteDescriptorSets[2] = {
             {
                 .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                 .pNext = VK_NULL_HANDLE,
@@ -2064,18 +3283,34 @@ void Resources::allocateParticleDescriptorSets(std::vector<VkDescriptorSet>& com
                 .pImageInfo = VK_NULL_HANDLE,
                 .pBufferInfo = &bufferInfo,
                 .pTexelBufferView = VK_NULL_HANDLE,
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = VK_NULL_HANDLE,
+                .dstSet = graphicDescriptorSets[i],
+                .dstBinding = 1,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .pImageInfo = VK_NULL_HANDLE,
+                .pBufferInfo = &particleUBOInfo,
+                .pTexelBufferView = VK_NULL_HANDLE,
             }
         };
-        vkUpdateDescriptorSets(m_device, 1, pWriteDescriptorSets, 0, VK_NULL_HANDLE);
+        vkUpdateDescriptorSets(m_device, 2, pWriteDescriptorSets, 0, VK_NULL_HANDLE);
     }
 }
 
 void Resources::createParticleGraphicPipeline(VkPipeline& graphicPipeline,
     VkPipelineLayout& graphicPipelineLayout,
-    VkDescriptorSetLayout graphicDescriptorSetLayout) const
+    VkDescriptorSetLayout graphicDescriptorSetLayout,
+    VkSampleCountFlagBits sampleCount,
+    VkFormat colorFormat,
+    VkFormat depthFormat) const
 {
-    VkShaderModule vertexShaderModule = createShaderModule(readShaderFile("./shaders/particles_vert.spv"));
-    VkShaderModule fragmentShaderModule = createShaderModule(readShaderFile("./shaders/particles_frag.spv"));
+    std::vector<std::string> shaders = pipelineShaders(ShaderPipeline::ParticleGraphic);
+    VkShaderModule vertexShaderModule = createShaderModule(shaders[0]);
+    VkShaderModule fragmentShaderModule = createShaderModule(shaders[1]);
     VkPipelineShaderStageCreateInfo shaderStageCreateInfos[2] = {
         {
             // Vertex shader stage
@@ -2104,7 +3339,7 @@ void Resources::createParticleGraphicPipeline(VkPipeline& graphicPipeline,
         .stride = sizeof(Particle),
         .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
     };
-    VkVertexInputAttributeDescription vertexInputAttributeDescription[2] = {
+    VkVertexInputAttributeDescription vertexInputAttributeDescription[3] = {
         {
             .location = 0,
             .binding = 0,
@@ -2116,6 +3351,12 @@ void Resources::createParticleGraphicPipeline(VkPipeline& graphicPipeline,
             .binding = 0,
             .format = VK_FORMAT_R32G32B32A32_SFLOAT,
             .offset = offsetof(Particle, color)
+        },
+        {
+            .location = 2,
+            .binding = 0,
+            .format = VK_FORMAT_R32G32B32_SFLOAT,
+            .offset = offsetof(Particle, prevPosition)
         }
     };
     VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = {
@@ -2124,7 +3365,7 @@ void Resources::createParticleGraphicPipeline(VkPipeline& graphicPipeline,
         .flags = 0,
         .vertexBindingDescriptionCount = 1,
         .pVertexBindingDescriptions = &vertexInputBindingDescription,
-        .vertexAttributeDescriptionCount = 2,
+        .vertexAttributeDescriptionCount = 3,
         .pVertexAttributeDescriptions = vertexInputAttributeDescription
     };
 
@@ -2166,9 +3407,9 @@ void Resources::createParticleGraphicPipeline(VkPipeline& graphicPipeline,
         .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
         .pNext = VK_NULL_HANDLE,
         .flags = 0,
-        .rasterizationSamples = m_MSAASampleCount,
-        .sampleShadingEnable = m_physicalDeviceFeature.sampleRateShading,
-        .minSampleShading = 0.25f,
+        .rasterizationSamples = sampleCount,
+        .sampleShadingEnable = m_physicalDeviceFeature.sampleRateShading && m_particleMinSampleShading > 0.f,
+        .minSampleShading = m_particleMinSampleShading,
         .pSampleMask = VK_NULL_HANDLE,
         .alphaToCoverageEnable = VK_FALSE,
         .alphaToOneEnable = VK_FALSE
@@ -2221,11 +3462,20 @@ void Resources::createParticleGraphicPipeline(VkPipeline& graphicPipeline,
         .pDynamicStates = dynamicStates
     };
 
-    createPipelineLayout(graphicPipelineLayout, graphicDescriptorSetLayout);
+    createPipelineLayout(graphicPipelineLayout, {graphicDescriptorSetLayout});
     
+    VkPipelineRenderingCreateInfoKHR pipelineRenderingCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+        .pNext = VK_NULL_HANDLE,
+        .viewMask = 0,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &colorFormat,
+        .depthAttachmentFormat = depthFormat,
+        .stencilAttachmentFormat = VK_FORMAT_UNDEFINED
+    };
     VkGraphicsPipelineCreateInfo createInfo = {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .pNext = VK_NULL_HANDLE,
+        .pNext = &pipelineRenderingCreateInfo,
         .flags = 0,
         .stageCount = 2,
         .pStages = shaderStageCreateInfos,
@@ -2239,7 +3489,7 @@ void Resources::createParticleGraphicPipeline(VkPipeline& graphicPipeline,
         .pColorBlendState = &colorBlendStateCreateInfo,
         .pDynamicState = &dynamicStateCreateInfo,
         .layout = graphicPipelineLayout,
-        .renderPass = m_renderPass,
+        .renderPass = VK_NULL_HANDLE,
         .subpass = 0,
         .basePipelineHandle = VK_NULL_HANDLE,
         .basePipelineIndex = -1
@@ -2252,16 +3502,18 @@ void Resources::createParticleGraphicPipeline(VkPipeline& graphicPipeline,
     vkDestroyShaderModule(m_device, fragmentShaderModule, VK_NULL_HANDLE);
 }
 
-void Resources::createPipelineLayout(VkPipelineLayout& pipelineLayout, VkDescriptorSetLayout descriptorSetLayout) const
+void Resources::createPipelineLayout(VkPipelineLayout& pipelineLayout, 
+    const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts,
+    const std::vector<VkPushConstantRange>& pushConstantRanges) const
 {
     VkPipelineLayoutCreateInfo createInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .pNext = VK_NULL_HANDLE,
         .flags = 0,
-        .setLayoutCount = 1,
-        .pSetLayouts = &descriptorSetLayout,
-        .pushConstantRangeCount = 0,
-        .pPushConstantRanges = VK_NULL_HANDLE
+        .setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size()),
+        .pSetLayouts = descriptorSetLayouts.data(),
+        .pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size()),
+        .pPushConstantRanges = pushConstantRanges.data()
     };
 
     if(vkCreatePipelineLayout(m_device, &createInfo, VK_NULL_HANDLE, &pipelineLayout) != VK_SUCCESS)
@@ -2301,7 +3553,7 @@ void Resources::cmdUpdateParticles(VkCommandBuffer commandBuffer,
 
 void Resources::loadParticles()
 {
-    m_particles->initParticleGroup(4096);
+    m_particles->initParticleGroup(4096, m_deterministic ? m_randomSeed : static_cast<uint32_t>(time(nullptr)));
 }
 
 void Resources::cmdDrawParticles(VkCommandBuffer commandBuffer, 
@@ -2319,15 +3571,15 @@ void Resources::cmdDrawParticles(VkCommandBuffer commandBuffer,
     VkViewport viewport = {
         .x = 0.f,
         .y = 0.f,
-        .width = static_cast<float>(m_swapChainImageExtent.width),
-        .height = static_cast<float>(m_swapChainImageExtent.height),
+        .width = static_cast<float>(m_renderExtent.width),
+        .height = static_cast<float>(m_renderExtent.height),
         .minDepth = 0.f,
         .maxDepth = 1.f
     };
     vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
     VkRect2D scissor = {
         .offset = {0, 0},
-        .extent = m_swapChainImageExtent
+        .extent = m_renderExtent
     };
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
@@ -2342,29 +3594,98 @@ void Resources::writePipelineCacheData() const
     std::vector<char> cacheData(sizeof(char) * dataSize);
     if(vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, cacheData.data()) != VK_SUCCESS)
         throw std::runtime_error("VK ERROR: Failed to get pipeline cache data.");
+    PipelineCacheFileHeader fileHeader = {
+        .magic = 0x43505056,  // "VPPC"
+        .driverVersion = m_physicalDeviceProperties.driverVersion,
+        .dataSize = dataSize,
+        .checksum = pipelineCacheChecksum(cacheData.data(), dataSize)
+    };
 
-    std::ofstream ofs(m_pipelineCachePath, std::ios::binary);
+    // Write a temporary file and move it over the old one, a crash halfway through never leaves a broken cache behind
+    std::string temporaryPath = m_pipelineCachePath + ".tmp";
+    std::ofstream ofs(temporaryPath, std::ios::binary | std::ios::trunc);
     if(!ofs.is_open())
-        throw std::runtime_error("VK ERROR:Failed to write pipline cache to" + m_pipelineCachePath + ".");
+        throw std::runtime_error("VK ERROR: Failed to write pipeline cache to " + temporaryPath + ".");
+    ofs.write(reinterpret_cast<const char*>(&fileHeader), sizeof(PipelineCacheFileHeader));
     ofs.write(cacheData.data(), dataSize);
     ofs.close();
+    if(!ofs)
+        throw std::runtime_error("VK ERROR: Failed to write pipeline cache to " + temporaryPath + ".");
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, m_pipelineCachePath, error);
+    if(error)
+        throw std::runtime_error("VK ERROR: Failed to replace pipeline cache " + m_pipelineCachePath + ", " + error.message() + ".");
+}
+
+void Resources::schedulePipelineCacheFlush()
+{
+    // Written every now and then on a pipeline worker, so a crash only loses what was compiled since the last flush
+    double currentTime = glfwGetTime();
+    if(currentTime - m_lastPipelineCacheFlush < m_pipelineCacheFlushInterval || m_pipelineCacheFlushing)
+        return;
+    m_lastPipelineCacheFlush = currentTime;
+    size_t dataSize;
+    if(vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, VK_NULL_HANDLE) != VK_SUCCESS || dataSize == m_flushedPipelineCacheSize)
+        return;
+    m_flushedPipelineCacheSize = dataSize;
+    m_pipelineCacheFlushing = true;
+    m_pipelineManager->enqueue([this]()
+    {
+        try
+        {
+            writePipelineCacheData();
+        }
+        catch(const std::runtime_error& error)
+        {
+            std::cout << "VK INFO: Pipeline cache flush skipped, " << error.what() << "\n";
+        }
+        m_pipelineCacheFlushing = false;
+    });
+}
+
+std::string Resources::pipelineCachePath() const
+{
+    // A cache of another GPU or driver is never handed to this one, and switching back and forth keeps both warm
+    std::stringstream ss;
+    ss << m_pipelineCacheDirectory << "pipeline_" << std::hex << std::setfill('0') 
+        << std::setw(4) << m_physicalDeviceProperties.vendorID << "_" 
+        << std::setw(4) << m_physicalDeviceProperties.deviceID << "_" 
+        << std::setw(8) << m_physicalDeviceProperties.driverVersion << "_";
+    for(uint32_t i = 0; i < VK_UUID_SIZE; ++i)
+        ss << std::setw(2) << static_cast<uint32_t>(m_physicalDeviceProperties.pipelineCacheUUID[i]);
+    ss << ".cache";
+    return ss.str();
+}
+
+uint64_t Resources::pipelineCacheChecksum(const char* data, size_t size)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for(size_t i = 0; i < size; ++i)
+    {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
 }
 
 void Resources::createPipelineCache()
 {
+    m_pipelineCachePath = pipelineCachePath();
     std::ifstream ifs(m_pipelineCachePath, std::ios::ate | std::ios::binary);
-    size_t dataSize = 0;
     std::vector<char> cacheData;
     if(ifs.is_open())
     {
-        dataSize = ifs.tellg();
-        cacheData.resize(dataSize);
+        std::vector<char> fileData(static_cast<size_t>(ifs.tellg()));
         ifs.seekg(0, std::ios::beg);
-        ifs.read(cacheData.data(), dataSize);
+        ifs.read(fileData.data(), fileData.size());
 
+        // A cache that does not validate is simply not used, it gets replaced on the next flush
         std::string info;
-        if(!isValidPipelineCacheData(cacheData.data(), dataSize, info))
-            throw std::runtime_error("VK ERROR: Incompatible pipeline cache data.\n" + info);
+        if(isValidPipelineCacheFile(fileData, info))
+            cacheData.assign(fileData.begin() + sizeof(PipelineCacheFileHeader), fileData.end());
+        else
+            std::cout << "VK INFO: Ignoring pipeline cache " << m_pipelineCachePath << ", starting with an empty one. " << info;
     }
     ifs.close();
 
@@ -2372,17 +3693,62 @@ void Resources::createPipelineCache()
         .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
         .pNext = VK_NULL_HANDLE,
         .flags = 0,
-        .initialDataSize = dataSize,
+        .initialDataSize = cacheData.size(),
         .pInitialData = cacheData.data(),
     };
-    
+    if(vkCreatePipelineCache(m_device, &pipelineCacheCreateInfo, VK_NULL_HANDLE, &m_pipelineCache) == VK_SUCCESS)
+    {
+        m_flushedPipelineCacheSize = cacheData.size();
+        return;
+    }
+
+    // The driver may still reject data that passed validation
+    pipelineCacheCreateInfo.initialDataSize = 0;
+    pipelineCacheCreateInfo.pInitialData = VK_NULL_HANDLE;
     if(vkCreatePipelineCache(m_device, &pipelineCacheCreateInfo, VK_NULL_HANDLE, &m_pipelineCache) != VK_SUCCESS)
-        throw std::runtime_error("");
+        throw std::runtime_error("VK ERROR: Failed to create pipeline cache.");
+    std::cout << "VK INFO: The driver rejected pipeline cache " << m_pipelineCachePath << ", starting with an empty one.\n";
+}
+
+VkBool32 Resources::isValidPipelineCacheFile(const std::vector<char>& fileData, std::string& info) const
+{
+    if(fileData.size() < sizeof(PipelineCacheFileHeader))
+    {
+        info += "File too small.\n";
+        return VK_FALSE;
+    }
+    PipelineCacheFileHeader fileHeader;
+    memcpy(&fileHeader, fileData.data(), sizeof(PipelineCacheFileHeader));
+    const char* cacheData = fileData.data() + sizeof(PipelineCacheFileHeader);
+    size_t dataSize = fileData.size() - sizeof(PipelineCacheFileHeader);
+    if(fileHeader.magic != 0x43505056 || fileHeader.dataSize != dataSize)
+    {
+        info += "Bad pipeline cache file header.\n";
+        return VK_FALSE;
+    }
+    if(fileHeader.driverVersion != m_physicalDeviceProperties.driverVersion)
+    {
+        std::stringstream ss;
+        ss << "Driver version mismatch, current device has: 0x" << std::hex << std::setfill('0') << std::setw(8) << 
+            m_physicalDeviceProperties.driverVersion << ",but pipeline cache data has: 0x" << std::setw(8) << fileHeader.driverVersion << ".\n";
+        info += ss.str();
+        return VK_FALSE;
+    }
+    if(fileHeader.checksum != pipelineCacheChecksum(cacheData, dataSize))
+    {
+        info += "Pipeline cache checksum mismatch.\n";
+        return VK_FALSE;
+    }
+    return isValidPipelineCacheData(cacheData, dataSize, info);
 }
 
 VkBool32 Resources::isValidPipelineCacheData(const char* buf, size_t size, std::string& info) const
 {
-    if(size < 32) return VK_FALSE;
+    if(size < 32)
+    {
+        info += "Pipeline cache data too small.\n";
+        return VK_FALSE;
+    }
     uint32_t header, version, vendor, deviceID;  // 4B
     uint8_t pipelineCacheUUID[VK_UUID_SIZE];  // 1B
     memcpy(&header, buf, 4);
@@ -2391,7 +3757,7 @@ VkBool32 Resources::isValidPipelineCacheData(const char* buf, size_t size, std::
     memcpy(&deviceID, buf + 12, 4);
     memcpy(pipelineCacheUUID, buf + 16, VK_UUID_SIZE);
 
-    if(header <= 0)
+    if(header < 32 || header > size)
     {
         std::stringstream ss;
         ss << std::hex << std::setfill('0') << std::setw(8) << header;
@@ -2457,4 +3823,336 @@ std::string Resources::getCurrentTime() const
     std::stringstream ss;
     ss << std::put_time(std::localtime(&timeT), "%Y%m%d%H%M%S");
     return ss.str();
+}
+
+void Resources::cmdCaptureSwapChainImage(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+    if(!(m_swapChainImageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+        throw std::runtime_error("VK ERROR: Swap chain images can't be a transfer source, frame capture is unavailable.");
+
+    if(m_captureBuffer == VK_NULL_HANDLE)
+    {
+        m_captureExtent = m_swapChainImageExtent;
+        createBuffer(4 * m_captureExtent.width * m_captureExtent.height, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            m_captureBuffer, m_captureBufferMemory);
+    }
+
+    // The render graph has the image in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL and presents it afterwards
+    VkBufferImageCopy bufferImageCopy = {
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        },
+        .imageOffset = {0, 0, 0},
+        .imageExtent = {m_captureExtent.width, m_captureExtent.height, 1}
+    };
+    vkCmdCopyImageToBuffer(commandBuffer, m_swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        m_captureBuffer, 1, &bufferImageCopy);
+
+    // Make the copy visible to the host
+    VkBufferMemoryBarrier2KHR bufferMemoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR,
+        .pNext = VK_NULL_HANDLE,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT_KHR,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR,
+        .dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT_KHR,
+        .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT_KHR,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = m_captureBuffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    VkDependencyInfoKHR dependencyInfo = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+        .bufferMemoryBarrierCount = 1,
+        .pBufferMemoryBarriers = &bufferMemoryBarrier
+    };
+    vkCmdPipelineBarrier2KHR(commandBuffer, &dependencyInfo);
+}
+
+void Resources::readCapturedImage()
+{
+    uint32_t pixelCount = m_captureExtent.width * m_captureExtent.height;
+    void* data;
+    vkMapMemory(m_device, m_captureBufferMemory, 0, 4 * pixelCount, 0, &data);
+    const uint8_t* pixels = static_cast<const uint8_t*>(data);
+
+    // Swap chain images are usually BGRA
+    bool bgra = m_swapChainImageFormat == VK_FORMAT_B8G8R8A8_SRGB || m_swapChainImageFormat == VK_FORMAT_B8G8R8A8_UNORM;
+    m_capturedImage.resize(3 * pixelCount);
+    for(uint32_t i = 0; i < pixelCount; ++i)
+    {
+        m_capturedImage[3 * i + 0] = pixels[4 * i + (bgra ? 2 : 0)];
+        m_capturedImage[3 * i + 1] = pixels[4 * i + 1];
+        m_capturedImage[3 * i + 2] = pixels[4 * i + (bgra ? 0 : 2)];
+    }
+    vkUnmapMemory(m_device, m_captureBufferMemory);
+}
+
+void Resources::reportCapturedImage() const
+{
+    if(m_capturedImage.empty()) return;
+    if(!m_capturePath.empty())
+    {
+        writePPM(m_capturePath, m_capturedImage, m_captureExtent.width, m_captureExtent.height);
+        std::cout << "CAPTURE INFO: Frame " << m_frameLimit << " written to " << m_capturePath << ".\n";
+    }
+    if(!m_goldenImagePath.empty())
+        compareWithGoldenImage(m_capturedImage, m_captureExtent.width, m_captureExtent.height);
+}
+
+void Resources::writePPM(const std::string& filePath, const std::vector<uint8_t>& rgb, uint32_t width, uint32_t height) const
+{
+    std::ofstream ofs(filePath, std::ios::binary);
+    if(!ofs.is_open())
+        throw std::runtime_error("CAPTURE ERROR: Failed to write " + filePath + ".");
+    ofs << "P6\n" << width << " " << height << "\n255\n";
+    ofs.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+    ofs.close();
+}
+
+std::vector<uint8_t> Resources::readPPM(const std::string& filePath, uint32_t& width, uint32_t& height) const
+{
+    std::ifstream ifs(filePath, std::ios::binary);
+    if(!ifs.is_open())
+        throw std::runtime_error("CAPTURE ERROR: Failed to read " + filePath + ".");
+
+    // Header tokens may be separated by comments
+    auto nextToken = [&ifs]() -> std::string
+    {
+        std::string token;
+        while(ifs >> token && token[0] == '#')
+            ifs.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        return token;
+    };
+    std::string magic = nextToken();
+    width = static_cast<uint32_t>(std::stoul(nextToken()));
+    height = static_cast<uint32_t>(std::stoul(nextToken()));
+    std::string maxValue = nextToken();
+    if(magic != "P6" || maxValue != "255")
+        throw std::runtime_error("CAPTURE ERROR: " + filePath + " is not an 8 bit binary PPM image.");
+    ifs.get();  // Single whitespace before the pixel data
+
+    std::vector<uint8_t> rgb(3 * static_cast<size_t>(width) * height);
+    ifs.read(reinterpret_cast<char*>(rgb.data()), rgb.size());
+    if(static_cast<size_t>(ifs.gcount()) != rgb.size())
+        throw std::runtime_error("CAPTURE ERROR: " + filePath + " is truncated.");
+    return rgb;
+}
+
+void Resources::compareWithGoldenImage(const std::vector<uint8_t>& rgb, uint32_t width, uint32_t height) const
+{
+    uint32_t goldenWidth, goldenHeight;
+    std::vector<uint8_t> golden = readPPM(m_goldenImagePath, goldenWidth, goldenHeight);
+    if(goldenWidth != width || goldenHeight != height)
+    {
+        std::stringstream ss;
+        ss << "CAPTURE ERROR: Golden image is " << goldenWidth << "x" << goldenHeight << 
+            " but the frame is " << width << "x" << height << ".";
+        throw std::runtime_error(ss.str());
+    }
+
+    size_t mismatchCount = 0;
+    uint32_t maxDifference = 0;
+    for(size_t i = 0; i < rgb.size(); i += 3)
+    {
+        uint32_t difference = 0;
+        for(size_t c = 0; c < 3; ++c)
+            difference = std::max<uint32_t>(difference, std::abs(int(rgb[i + c]) - int(golden[i + c])));
+        maxDifference = std::max(maxDifference, difference);
+        if(difference > m_goldenTolerance) ++mismatchCount;
+    }
+
+    size_t pixelCount = rgb.size() / 3;
+    std::cout << "CAPTURE INFO: " << mismatchCount << " of " << pixelCount << " pixels differ from " << m_goldenImagePath << 
+        " by more than " << m_goldenTolerance << ", max difference " << maxDifference << ".\n";
+    if(static_cast<float>(mismatchCount) > m_goldenMaxMismatchRatio * pixelCount)
+        throw std::runtime_error("CAPTURE ERROR: Frame does not match golden image " + m_goldenImagePath + ".");
+}
+
+void Resources::collectTimestamps()
+{
+    // Called once m_currentFrameIndex's graphic work and the compute work submitted along with it have completed
+    if(m_timestampQueryPool == VK_NULL_HANDLE || !m_timestampsWritten[m_currentFrameIndex])
+        return;
+    m_timestampsWritten[m_currentFrameIndex] = false;
+
+    uint32_t computeFrameIndex = (m_currentFrameIndex + 1) % m_maxInflightFrames;
+    uint64_t computeTimestamps[2], graphicTimestamps[2];
+    if(vkGetQueryPoolResults(m_device, m_timestampQueryPool, 4 * computeFrameIndex, 2, sizeof(computeTimestamps), computeTimestamps, 
+        sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS ||
+        vkGetQueryPoolResults(m_device, m_timestampQueryPool, 4 * m_currentFrameIndex + 2, 2, sizeof(graphicTimestamps), graphicTimestamps, 
+        sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        return;
+    for(uint64_t& timestamp: computeTimestamps) timestamp &= m_timestampMask;
+    for(uint64_t& timestamp: graphicTimestamps) timestamp &= m_timestampMask;
+
+    // unit: milliseconds
+    double tickToMs = m_physicalDeviceProperties.limits.timestampPeriod * 1e-6;
+    uint64_t overlapBegin = std::max(computeTimestamps[0], graphicTimestamps[0]),
+        overlapEnd = std::min(computeTimestamps[1], graphicTimestamps[1]);
+    m_computeTimeTotal += (computeTimestamps[1] - computeTimestamps[0]) * tickToMs;
+    m_graphicTimeTotal += (graphicTimestamps[1] - graphicTimestamps[0]) * tickToMs;
+    m_overlapTimeTotal += overlapEnd > overlapBegin ? (overlapEnd - overlapBegin) * tickToMs : 0.0;
+    ++m_timestampSampleCount;
+    std::pair<double, uint32_t>& MSAAFrameTime = m_MSAAFrameTimes[m_timestampSampleCounts[m_currentFrameIndex]];
+    MSAAFrameTime.first += (graphicTimestamps[1] - graphicTimestamps[0]) * tickToMs;
+    ++MSAAFrameTime.second;
+    if(m_targetFrameTime > 0.f)
+        updateRenderScale((graphicTimestamps[1] - graphicTimestamps[0]) * tickToMs);
+}
+
+void Resources::updateRenderScale(double gpuFrameTime)
+{
+    // GPU time grows about with the pixel count, the square of the scale. Within 5% of the target nothing changes, 
+    // otherwise the scale moves part of the way to where the target would be met: quickly down so load spikes get 
+    // headroom within a few frames, slowly back up so it doesn't oscillate.
+    double ratio = m_targetFrameTime / std::max(gpuFrameTime, 1e-3);
+    if(std::abs(1.0 - ratio) > 0.05)
+    {
+        double desiredScale = m_renderScale * std::sqrt(ratio);
+        double rate = desiredScale < m_renderScale ? 0.5 : 0.1;
+        m_renderScale = std::clamp(static_cast<float>(m_renderScale + rate * (desiredScale - m_renderScale)), m_minRenderScale, 1.f);
+        updateRenderExtent();
+    }
+    m_renderScaleTotal += m_renderScale;
+    m_renderScaleLowest = std::min(m_renderScaleLowest, m_renderScale);
+    ++m_renderScaleSampleCount;
+}
+
+void Resources::updateRenderExtent()
+{
+    // Steps of 8 pixels keep cached command buffers from re-recording on every small change
+    VkExtent2D renderExtent = m_swapChainImageExtent;
+    if(m_renderScale < 1.f)
+    {
+        renderExtent.width = std::clamp(static_cast<uint32_t>(m_swapChainImageExtent.width * m_renderScale) & ~7u, 
+            std::min(8u, m_swapChainImageExtent.width), m_swapChainImageExtent.width);
+        renderExtent.height = std::clamp(static_cast<uint32_t>(m_swapChainImageExtent.height * m_renderScale) & ~7u, 
+            std::min(8u, m_swapChainImageExtent.height), m_swapChainImageExtent.height);
+    }
+    if(renderExtent.width != m_renderExtent.width || renderExtent.height != m_renderExtent.height)
+    {
+        m_renderExtent = renderExtent;
+        invalidateDrawCommands();
+    }
+}
+
+void Resources::reportDynamicResolution() const
+{
+    if(m_renderScaleSampleCount == 0)
+        return;
+    std::cout << "VK INFO: Dynamic resolution targeting " << m_targetFrameTime << "ms rendered at " 
+        << m_renderScaleTotal / m_renderScaleSampleCount * 100.0 << "% scale on average, " 
+        << m_renderScaleLowest * 100.f << "% at the lowest over " << m_renderScaleSampleCount << " frames.\n";
+}
+
+void Resources::reportTimestamps() const
+{
+    if(m_timestampSampleCount == 0)
+        return;
+    double overlapRatio = m_computeTimeTotal > 0.0 ? m_overlapTimeTotal / m_computeTimeTotal : 0.0;
+    std::cout << "VK INFO: Over " << m_timestampSampleCount << " frames, particle simulation took " 
+        << m_computeTimeTotal / m_timestampSampleCount << "ms and drawing " 
+        << m_graphicTimeTotal / m_timestampSampleCount << "ms per frame on average, " 
+        << overlapRatio * 100.0 << "% of the simulation overlapped with drawing.\n";
+}
+
+void Resources::collectInputLatency()
+{
+    // A frame counts as presented once its graphic work is done, the time the compositor takes to scan it out is 
+    // not visible to us
+    uint64_t completedSerial = completedFrameSerial();
+    double now = glfwGetTime();
+    while(!m_pendingInputSamples.empty() && m_pendingInputSamples.front().first <= completedSerial)
+    {
+        double latency = (now - m_pendingInputSamples.front().second) * 1000.0;  // unit: milliseconds
+        m_inputLatencyTotal += latency;
+        m_inputLatencyMax = std::max(m_inputLatencyMax, latency);
+        ++m_inputLatencySampleCount;
+        m_pendingInputSamples.pop_front();
+    }
+}
+
+void Resources::reportInputLatency() const
+{
+    if(m_inputLatencySampleCount == 0)
+        return;
+
+    // One line per preset and configuration: preset, frames in flight, swapchain images, present mode, average, 
+    // worst and frame count. This run replaces the previous result of the same configuration.
+    struct LatencyResult
+    {
+        std::string preset;
+        uint32_t framesInFlight, swapChainImages;
+        std::string presentMode;
+        double average, worst;
+        uint32_t frames;
+    };
+    LatencyResult current = {m_presetName, m_maxInflightFrames, static_cast<uint32_t>(m_swapChainImages.size()), 
+        presentModeName(m_presentMode), m_inputLatencyTotal / m_inputLatencySampleCount, m_inputLatencyMax, 
+        m_inputLatencySampleCount};
+    std::vector<LatencyResult> results;
+    std::ifstream ifs(m_latencyResultsPath);
+    LatencyResult stored;
+    while(ifs >> stored.preset >> stored.framesInFlight >> stored.swapChainImages >> stored.presentMode >> 
+        stored.average >> stored.worst >> stored.frames)
+        if(stored.preset != current.preset || stored.framesInFlight != current.framesInFlight || 
+            stored.swapChainImages != current.swapChainImages || stored.presentMode != current.presentMode)
+            results.push_back(stored);
+    ifs.close();
+    results.push_back(current);
+
+    std::ofstream ofs(m_latencyResultsPath);
+    for(const LatencyResult& result: results)
+        ofs << result.preset << " " << result.framesInFlight << " " << result.swapChainImages << " " << result.presentMode << " " 
+            << result.average << " " << result.worst << " " << result.frames << "\n";
+    if(!ofs)
+        std::cout << "VK INFO: Failed to write latency results to " << m_latencyResultsPath << ".\n";
+
+    std::cout << "VK INFO: Input-to-present latency per preset, this run and the last run of every other one in " 
+        << m_latencyResultsPath << ":\n";
+    for(const LatencyResult& result: results)
+        std::cout << "VK INFO:   " << std::left << std::setw(12) << result.preset << std::right << " " << result.framesInFlight 
+            << " frames in flight, " << result.swapChainImages << " swapchain images, " << std::setw(12) << result.presentMode 
+            << ": " << std::fixed << std::setprecision(2) << result.average << "ms on average, " << result.worst << "ms at most over " 
+            << std::defaultfloat << result.frames << " frames.\n";
+}
+
+std::vector<VkPresentModeKHR> Resources::parsePresentModes(const std::string& presentModeList)
+{
+    // Comma separated, most preferred first, e.g. "immediate,mailbox,fifo"
+    std::vector<VkPresentModeKHR> presentModes;
+    std::stringstream stream(presentModeList);
+    std::string name;
+    while(std::getline(stream, name, ','))
+    {
+        if(name == "immediate") presentModes.push_back(VK_PRESENT_MODE_IMMEDIATE_KHR);
+        else if(name == "mailbox") presentModes.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
+        else if(name == "fifo") presentModes.push_back(VK_PRESENT_MODE_FIFO_KHR);
+        else if(name == "fifo-relaxed") presentModes.push_back(VK_PRESENT_MODE_FIFO_RELAXED_KHR);
+        else throw std::runtime_error("ARGS ERROR: Unknown present mode " + name + ", expected immediate, mailbox, fifo or fifo-relaxed.");
+    }
+    if(presentModes.empty())
+        throw std::runtime_error("ARGS ERROR: --present-mode needs at least one present mode.");
+    return presentModes;
+}
+
+const char* Resources::presentModeName(VkPresentModeKHR presentMode)
+{
+    switch(presentMode)
+    {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:     return "IMMEDIATE";
+        case VK_PRESENT_MODE_MAILBOX_KHR:       return "MAILBOX";
+        case VK_PRESENT_MODE_FIFO_KHR:          return "FIFO";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:  return "FIFO_RELAXED";
+        default:                                return "UNKNOWN";
+    }
 }
\ No newline at end of file
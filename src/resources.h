@@ -13,10 +13,25 @@
 #include <optional>
 #include <set>
 #include <map>
+#include <deque>
+#include <functional>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <filesystem>
+#include <chrono>
 
 // Forward declaration
 class Model;
 class ParticleGroup;
+class ThreadPool;
+class DescriptorAllocator;
+class RenderGraph;
+class TextureLoader;
+class PipelineManager;
+struct PipelineKey;
+struct PipelineSwap;
+enum class ShaderPipeline;
 struct Vertex;
 struct Texture;
 struct Particle;
@@ -34,6 +49,7 @@ private:
         std::optional<uint32_t> graphicFamily;
         std::optional<uint32_t> presentFamily;
         std::optional<uint32_t> graphicComputeFamily;
+        std::optional<uint32_t> computeFamily;  // Compute without graphics, only set if the device has such a family
 
         bool isComplete()
         {
@@ -42,7 +58,16 @@ private:
 
         std::set<uint32_t> getUniqueFamilyInidces()
         {
-            return std::set<uint32_t>({graphicFamily.value(), presentFamily.value(), graphicComputeFamily.value()});
+            std::set<uint32_t> uniqueFamilyIndices({graphicFamily.value(), presentFamily.value(), graphicComputeFamily.value()});
+            if(computeFamily.has_value())
+                uniqueFamilyIndices.insert(computeFamily.value());
+            return uniqueFamilyIndices;
+        }
+
+        // Family the particle simulation is submitted to
+        uint32_t asyncComputeFamily()
+        {
+            return computeFamily.value_or(graphicComputeFamily.value());
         }
 
         std::vector<uint32_t> getAllFamilyIndices()
@@ -51,6 +76,41 @@ private:
         }
     };
 
+    // Per frame in flight and recording thread
+    struct RecordContext
+    {
+        VkCommandPool commandPool;
+        std::vector<VkCommandBuffer> commandBuffers;  // Secondary, allocated on demand and reused every frame
+        uint32_t usedCount = 0;
+    };
+
+    // Per frame in flight, draw command buffers recorded once for every swapchain image and replayed until invalidated
+    struct DrawCommandCache
+    {
+        VkCommandPool commandPool;
+        std::vector<VkCommandBuffer> commandBuffers;  // [swapchain image index]
+        std::vector<bool> recorded;
+        uint64_t generation = 0;  // Compared with m_drawCommandGeneration
+    };
+
+    // Written in front of the driver's cache data. The driver version is not part of the Vulkan cache header and the 
+    // checksum catches files damaged on disk.
+    struct PipelineCacheFileHeader
+    {
+        uint32_t magic;
+        uint32_t driverVersion;
+        uint64_t dataSize;
+        uint64_t checksum;
+    };
+
+    // A shader source and the pipelines it is compiled into, for hot reload
+    struct ShaderSource
+    {
+        std::string source;
+        std::string spirv;
+        std::vector<ShaderPipeline> pipelines;
+    };
+
     struct SwapChainSupportDetails
     {
         VkSurfaceCapabilitiesKHR surfaceCapabilities;  // To get the created swap chain extent
@@ -65,6 +125,7 @@ private:
 
 public:
     // functions to init vulkan resouces(in order)
+    void parseCommandLineArguments(int argc, char** argv);
     void distributeResources();
     void initWindow();
     void mainLoop();
@@ -76,26 +137,36 @@ public:
     void createLogicalDevices();
     void createSwapChain();
     void createSwapChainImageViews();
-    void createColorResources();
-    void createDepthResources();
+    void createRenderGraph();
+    void reportAttachmentMemory() const;
     void createCommandPool();
     void allocateCommandBuffers();
     void createDescriptorSetLayout();
-    void createRenderPass();
     void createPipelineCache();
+    void createPipelineManager();
     void createPipeline();
-    void createSwapChainFrameBuffers();
     void createSyncObjects();
+    void createTimestampQueryPool();
+    void createTextureLoader();
     void loadModel();
     void loadParticles();
     void createDrawUniformBuffers();
-    void createDescriptorPool();
+    void createDescriptorAllocators();
+    void createBindlessDescriptorSet();
     void allocateDescriptorSets();
     void cleanUp();
+    void reportCapturedImage() const;
 
     // public interface
     bool isValidationLayerEnbaled() const { return m_enableValidationLayer; }
     VkExtent2D windowSize() const { return {m_windowWidth, m_windowHeight}; }
+    uint32_t maxInflightFrames() const { return m_maxInflightFrames; }
+    uint32_t graphicQueueFamily() const { return m_graphicQueueFamily; }
+    uint32_t computeQueueFamily() const { return m_computeQueueFamily; }
+    VkQueue graphicQueue() const { return m_graphicQueue; }
+    float simulationTimeStep() const { return m_simulationTimeStep; }
+    uint64_t submittedFrameSerial() const { return m_frameSerial; }
+    uint64_t completedFrameSerial() const;  // Resources last used by a frame serial up to this one can be reclaimed
     static Resources* get();
     bool m_complete = false;
 
@@ -105,15 +176,16 @@ public:
         VkMemoryPropertyFlags requiredMemoryProperty, VkImage& image, VkDeviceMemory& imageMemory) const;
     void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags requiredProperties, 
         VkBuffer& buffer, VkDeviceMemory& memory) const;
-    void copyBuffer2Buffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) const;
-    void copyBuffer2Image(VkBuffer srcBuffer, VkImage dstImage, uint32_t width, uint32_t height) const;
-    void transitionImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout, VkImage image, uint32_t mipLevels) const;
+    void copyBuffer2Buffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, bool onComputeQueue = false) const;
     void createTexture(const char* filename, Texture& texture) const;
+    bool isTextureFormatSupported(VkFormat format) const;
+    bool compressedTexturesEnabled() const { return m_compressedTextures; }
     void createSampler(VkSampler& sampler, uint32_t mipLevel) const;
-    void createImageView(VkImageView& imageView, VkImage image, VkFormat format, VkImageAspectFlags aspect) const;
+    void createImageView(VkImageView& imageView, VkImage image, VkFormat format, VkImageAspectFlags aspect, uint32_t mipLevels = 1) const;
     uint32_t findMemoryTypeIndex(uint32_t requiredMemoryTypeBit, VkMemoryPropertyFlags requirdMemoryPropertyFlags) const;
-    VkCommandBuffer beginSingleTimeCommandBuffer() const;
-    void endSingleTimeCommandBuffer(VkCommandBuffer commandBuffer) const;
+    std::optional<uint32_t> tryFindMemoryTypeIndex(uint32_t requiredMemoryTypeBit, VkMemoryPropertyFlags requirdMemoryPropertyFlags) const;
+    VkCommandBuffer beginSingleTimeCommandBuffer(bool onComputeQueue = false) const;
+    void endSingleTimeCommandBuffer(VkCommandBuffer commandBuffer, bool onComputeQueue = false) const;
     void createModelVertexBuffer(const std::vector<Vertex>& vertices, VkBuffer& vertexBuffer, VkDeviceMemory& vertexBufferMemory) const;
     void createModelIndexBuffer(const std::vector<uint32_t>& indices, VkBuffer& indexBuffer, VkDeviceMemory& indexBufferMemory) const;
     void createParticleUBOs(std::vector<VkBuffer>& particleUBOs, 
@@ -121,13 +193,24 @@ public:
         std::vector<void*>& particleUBOMapped);
     void createParticleSSBOs(std::vector<VkBuffer>& particleSSBOs, 
         std::vector<VkDeviceMemory>& particleSSBOMemories,
-        const std::vector<Particle>& particles) const;
+        const std::vector<Particle>& particles,
+        uint32_t bufferCount,
+        bool computeQueueOwned) const;
     void cleanUpTexture(const Texture& texture) const;
-    void generateMipmaps(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels) const;
+    void deferDestruction(std::function<void()> destroy) const;
+    void retireBuffer(VkBuffer buffer, VkDeviceMemory memory) const;
+    void retireTexture(const Texture& texture) const;
+    uint32_t registerBindlessTexture(const Texture& texture);
+    void retireBindlessTexture(uint32_t index) const;
+    void reloadModel();
+    void reloadPipelines();
+    VkDevice device() const { return m_device; }
+    // Expects every level in TRANSFER_DST with level 0 written, leaves them all in SHADER_READ_ONLY
+    void cmdGenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels) const;
     void allocateParticleDescriptorSets(std::vector<VkDescriptorSet>& computeDescriptorSets, 
         std::vector<VkDescriptorSet>& graphicDescriptorSets,
         const std::vector<VkBuffer>& particleUBOs, 
-        const std::vector<VkBuffer>& particleSSBOs,
+        const std::vector<VkBuffer>& simulationSSBOs,
         VkDescriptorSetLayout graphicDescriptorSetLayout,
         VkDescriptorSetLayout computeDescriptorSetLayout) const;
     void cmdUpdateParticles(VkCommandBuffer commandBuffer, 
@@ -148,7 +231,10 @@ public:
         VkDescriptorSetLayout computeDescriptorSetLayout) const;
     void createParticleGraphicPipeline(VkPipeline& graphicPipeline,
         VkPipelineLayout& graphicPipelineLayout,
-        VkDescriptorSetLayout graphicDescriptorSetLayout) const;
+        VkDescriptorSetLayout graphicDescriptorSetLayout,
+        VkSampleCountFlagBits sampleCount,
+        VkFormat colorFormat,
+        VkFormat depthFormat) const;
 private:
     // Callback funtions
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugMessageCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -157,14 +243,47 @@ private:
         void* pUserData);
     static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
     static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+    static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
     // private helper functions
     VkBool32 isValidPipelineCacheData(const char* buf, size_t size, std::string& info) const;
+    VkBool32 isValidPipelineCacheFile(const std::vector<char>& fileData, std::string& info) const;
+    std::string pipelineCachePath() const;
+    void schedulePipelineCacheFlush();
+    static uint64_t pipelineCacheChecksum(const char* data, size_t size);
     std::string getCurrentTime() const;
-    void createPipelineLayout(VkPipelineLayout& pipelineLayout, VkDescriptorSetLayout descriptorSetLayout) const;
+    void cmdCaptureSwapChainImage(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void readCapturedImage();
+    void writePPM(const std::string& filePath, const std::vector<uint8_t>& rgb, uint32_t width, uint32_t height) const;
+    std::vector<uint8_t> readPPM(const std::string& filePath, uint32_t& width, uint32_t& height) const;
+    void compareWithGoldenImage(const std::vector<uint8_t>& rgb, uint32_t width, uint32_t height) const;
+    void applyPreset(const std::string& presetName);
+    void collectInputLatency();
+    void reportInputLatency() const;
+    static std::vector<VkPresentModeKHR> parsePresentModes(const std::string& presentModeList);
+    static const char* presentModeName(VkPresentModeKHR presentMode);
+    void createPipelineLayout(VkPipelineLayout& pipelineLayout, 
+        const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts,
+        const std::vector<VkPushConstantRange>& pushConstantRanges = {}) const;
+    static uint32_t allocateBindlessSlot(std::vector<uint32_t>& freeSlots, uint32_t& slotCount, uint32_t capacity, const char* kind);
+    void createScenePipeline(VkPipeline& pipeline, VkPipelineLayout& pipelineLayout, 
+        VkSampleCountFlagBits sampleCount, VkFormat colorFormat, VkFormat depthFormat, bool depthOnly = false) const;
+    PipelineKey currentPipelineKey() const;
+    void createPipeline(const PipelineKey& key);
+    PipelineSwap buildPipeline(ShaderPipeline pipeline, const PipelineKey& key) const;
+    std::vector<std::string> pipelineShaders(ShaderPipeline pipeline) const;
+    void warmUpPipelines(const PipelineKey& key, const PipelineKey& currentKey) const;
+    void pollShaderSources();
+    void rebuildShaders(const std::vector<ShaderSource>& changedShaders, const PipelineKey& key);
+    void applyPipelineSwaps();
     std::vector<char> readShaderFile(const std::string filePath) const;
-    VkShaderModule createShaderModule(std::vector<char> shaderBytes) const;
+    VkShaderModule createShaderModule(const std::string& spirvName) const;
+    VkShaderModule createShaderModule(const uint32_t* code, size_t codeSize) const;
     VkSampleCountFlagBits getMSAASampleCount() const;
+    VkSampleCountFlagBits chooseMSAASampleCount(uint32_t requestedSampleCount) const;
+    uint32_t nextMSAASampleCount() const;
+    void applyMSAASampleCount();
+    void reportMSAAFrameTimes() const;
     bool checkInstanceValidationLayersSupported(std::vector<const char*> validationLayerNames) const;
     void populateMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& messengerCreateInfo) const;
     std::vector<const char*> getRequiredExtentions() const;
@@ -181,15 +300,33 @@ private:
         VkFormatFeatureFlags desiredFeatures) const;
     void updateUniformBuffers();
     void recordDrawCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
-    void recordComputeCommandBuffer(VkCommandBuffer commandBuffer);
+    void cmdRenderFrameGraph(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void cmdDrawScene(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount, bool depthOnly = false) const;
+    std::vector<VkCommandBuffer> recordSecondaryCommandBuffers(uint32_t imageIndex);
+    VkCommandBuffer acquireSecondaryCommandBuffer(RecordContext& recordContext) const;
+    void reportRecordingTime() const;
+    void reportDrawThroughput() const;
+    uint32_t sceneDrawCount() const;
+    VkCommandBuffer cachedDrawCommandBuffer(uint32_t imageIndex, bool& needsRecording);
+    void recordParticleAcquire(VkCommandBuffer commandBuffer);
+    void invalidateDrawCommands() { ++m_drawCommandGeneration; }
+    void recordComputeCommandBuffer(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+    void collectTimestamps();
+    void reportTimestamps() const;
+    void updateRenderScale(double gpuFrameTime);
+    void updateRenderExtent();
+    void reportDynamicResolution() const;
     void cleanUpSwapChain();
     void recreateSwapChain();
+    void runDeferredDestructions(uint64_t completedSerial);
 private:
     // class instance
     static Resources* instance;
 
     // Model
     Model* m_model;
+    std::string m_modelPath = "./model/viking_room.obj";
+    std::string m_texturePath = "./textures/viking_room.png";
 
     // Particle group
     ParticleGroup* m_particles;
@@ -198,15 +335,59 @@ private:
     GLFWwindow* m_window;
     uint32_t m_windowWidth = 1920, 
         m_windowHeight = 1080;
-    uint32_t m_maxInflightFrames = 2;
+    uint32_t m_maxInflightFrames = 2;  // 1 to 4
     uint32_t m_currentFrameIndex = 0;
     VkBool32 m_framebufferResized = VK_FALSE;
     VkBool32 m_mouseLeftButtonDown = VK_FALSE;
+    VkBool32 m_presentModeChanged = VK_FALSE;  // Preference list was switched at runtime, recreate the swapchain
+    VkBool32 m_reloadRequested = VK_FALSE;
+
+    // shader hot reload, sources in m_shaderDirectory are polled for changes and recompiled with glslc
+    std::string m_shaderDirectory = "./shaders/";
+    std::string m_glslcPath;  // --glslc, defaults to the Vulkan SDK's or the one on PATH
+    std::map<std::string, std::filesystem::file_time_type> m_shaderWriteTimes;
+    double m_lastShaderPoll = 0.0;
+    std::atomic<bool> m_shaderRebuildPending = false;
+    mutable std::mutex m_reloadedShaderMutex;
+    std::set<std::string> m_reloadedShaders;  // SPIR-V in m_shaderDirectory that replaces the embedded one
 
     // time related class varables
     double m_timeLastFrame = 0.f,
         m_timeCurrentFrame = 0.f;
 
+    // fixed timestep particle simulation
+    const float m_simulationTimeStep = 1.f / 120.f;  // unit: seconds
+    const uint32_t m_maxSimulationSubsteps = 8;  // Steps beyond this are dropped so a stall can't snowball
+    double m_simulationAccumulator = 0.f;
+    uint32_t m_simulationSubstepCount = 0;  // Steps to record into the next frame's compute command buffer
+    float m_interpolationAlpha = 0.f;  // Blend factor of the state the compute queue is stepping, drawn next frame
+
+    // deterministic replay: seeded particles, simulated clock and an optional capture of the last frame
+    bool m_deterministic = false;
+    uint32_t m_randomSeed = 1234;
+    bool m_headless = false;
+    uint32_t m_frameLimit = 0;  // 0 means run until the window is closed
+    uint32_t m_frameCount = 0;
+    std::string m_capturePath;
+    std::string m_goldenImagePath;
+    uint32_t m_goldenTolerance = 2;  // Max per-channel difference for a pixel to count as matching
+    float m_goldenMaxMismatchRatio = 0.001f;  // Fraction of pixels allowed to exceed the tolerance
+    VkBuffer m_captureBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_captureBufferMemory = VK_NULL_HANDLE;
+    VkExtent2D m_captureExtent;
+    std::vector<uint8_t> m_capturedImage;  // RGB8, filled after the main loop
+
+    // frame pacing, set by --preset, --frames-in-flight, --swapchain-images and --present-mode
+    std::string m_presetName = "default";
+    uint32_t m_swapChainImageCount = 0;  // 0 means minImageCount + 1
+    std::vector<VkPresentModeKHR> m_presentModePreference = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR};  // Most preferred first
+    double m_inputSampleTime = 0.0;  // When input was last polled
+    std::deque<std::pair<uint64_t, double>> m_pendingInputSamples;  // Frame serial and the input sample time it was built from
+    double m_inputLatencyTotal = 0.0,  // unit: milliseconds
+        m_inputLatencyMax = 0.0;
+    uint32_t m_inputLatencySampleCount = 0;
+    std::string m_latencyResultsPath = "./latency_presets.txt";  // Last result of every preset, printed together on exit
+
     // vulkan instance
     VkInstance m_vkInstance;
     VkDebugUtilsMessengerEXT m_vkMessenger;
@@ -227,48 +408,122 @@ private:
 
     // vulkan device
     VkDevice m_device;
-    std::vector<const char*> m_deviceExtensionNames = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    std::vector<const char*> m_deviceExtensionNames = {VK_KHR_SWAPCHAIN_EXTENSION_NAME, 
+        VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME, 
+        VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME};
 
     // vulkan queue families
     VkQueue m_graphicQueue;  // Queue supports graphic operations(and definitly supports transfer opeartions)
     VkQueue m_vkPresentQueue;  // Queue supports presenting images to a vulkan surface
     VkQueue m_graphicComputeQueue;  // Queue supports graphic operations and compution operations
+    VkQueue m_computeQueue;  // Queue the particle simulation runs on, from a compute only family if there is one
+    uint32_t m_graphicQueueFamily, 
+        m_computeQueueFamily;
 
     // swapchain resources
-    VkSwapchainKHR m_vkSwapChain;
+    VkSwapchainKHR m_vkSwapChain = VK_NULL_HANDLE;
     std::vector<VkImage> m_swapChainImages;
     std::vector<VkImageView> m_swapChainImageViews;
-    std::vector<VkFramebuffer> m_swapChainFrameBuffers;
+    std::vector<std::function<void()>> m_retiredSwapChains;  // Replaced swapchains waiting for an acquire from the new one
     VkFormat m_swapChainImageFormat;
     VkExtent2D m_swapChainImageExtent;
+    VkImageUsageFlags m_swapChainImageUsage;
     VkPresentModeKHR m_presentMode;
 
-    // renderpass
-    VkRenderPass m_renderPass;
 
     // descriptor set
-    VkDescriptorPool m_descriptorPool;
+    DescriptorAllocator* m_descriptorAllocator = VK_NULL_HANDLE;  // Sets that live until shutdown
     std::vector<VkDescriptorSet> m_graphicDescriptorSets; 
 
+    // bindless descriptor set, every texture is addressed by its index
+    VkDescriptorSetLayout m_bindlessDescriptorSetLayout;
+    VkDescriptorPool m_bindlessDescriptorPool;
+    VkDescriptorSet m_bindlessDescriptorSet;
+    uint32_t m_bindlessTextureCapacity = 4096;  // Clamped to the device's update-after-bind limits
+    uint32_t m_bindlessTextureCount = 0;  // Slots handed out so far, freed ones are reused first
+    mutable std::vector<uint32_t> m_freeBindlessTextures;
+
     // pipeline 
-    VkPipelineLayout m_graphicPipelineLayout;
+    VkPipelineLayout m_graphicPipelineLayout = VK_NULL_HANDLE;
     VkDescriptorSetLayout m_graphicDescriptorSetLayout;
-    VkPipeline m_graphicPipeline;
+    VkPipeline m_graphicPipeline = VK_NULL_HANDLE;
+    // Depth pre-pass, set by --depth-prepass. Lays down depth first, the scene pipeline then only shades what passes EQUAL.
+    bool m_depthPrepass = false;
+    VkPipelineLayout m_depthPrepassPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_depthPrepassPipeline = VK_NULL_HANDLE;
+    bool m_overdrawView = false;  // --overdraw, the scene pipeline adds up a constant per shaded fragment instead of texturing
+    bool m_compressedTextures = true;  // Prefer a block compressed .ktx2 next to a texture, --rgba8-textures turns it off
+    // Threads decoding textures, --texture-threads, one per core by default and 0 decodes on the loading thread
+    std::optional<uint32_t> m_textureThreadCount;
+    uint32_t m_textureLoadTestCount = 0;  // --texture-load-test, loads the model's texture this many times at startup
+    TextureLoader* m_textureLoader = VK_NULL_HANDLE;
     VkPipelineCache m_pipelineCache;
-    std::string m_pipelineCachePath = "./graphicPipeline.cache";
+    std::string m_pipelineCacheDirectory = "./";
+    std::string m_pipelineCachePath;  // One file per vendor, device, driver version and cache UUID
+    double m_pipelineCacheFlushInterval = 30.0;  // unit: seconds
+    double m_lastPipelineCacheFlush = 0.0;
+    size_t m_flushedPipelineCacheSize = 0;
+    std::atomic<bool> m_pipelineCacheFlushing = false;
+
+    // Pipelines compile on worker threads, frames only draw once a complete set of them is installed
+    PipelineManager* m_pipelineManager = VK_NULL_HANDLE;
+    bool m_pipelinesReady = false;
+    std::string m_pipelineManifestPath = "./pipeline.manifest";
 
     // command buffers
     VkCommandPool m_graphicCommandPool, 
         m_computeCommandPool;
     std::vector<VkCommandBuffer> m_graphicCommandBuffers,
         m_computeCommandBuffers;
+
+    // multithreaded recording, set by --record-threads and --draw-chunks. 0 threads records inline on the main thread
+    uint32_t m_recordThreadCount = 0;
+    uint32_t m_drawChunkCount = 1;  // Draw calls the model is split into
+    ThreadPool* m_recordThreadPool = VK_NULL_HANDLE;
+    std::vector<std::vector<RecordContext>> m_recordContexts;  // [frame index][recording thread]
+    double m_recordTimeTotal = 0.0;  // unit: milliseconds
+    uint32_t m_recordSampleCount = 0;
+
+    // Per-draw data, set by --objects and --per-draw-data. Each object is the model with its own transform
+    uint32_t m_objectCount = 1;
+    bool m_perDrawPushConstants = false;  // Push the transform instead of offsetting into the ring
+    std::vector<glm::mat4> m_objectTransforms;
+    std::chrono::steady_clock::time_point m_drawBenchmarkBegin, 
+        m_drawBenchmarkEnd;
+    uint32_t m_drawBenchmarkFrameCount = 0;  // Frames that drew the scene
+
+    // Draw command buffer cache, set by --cache-commands. Bumping the generation makes every frame index re-record
+    bool m_cacheDrawCommands = false;
+    std::vector<DrawCommandCache> m_drawCommandCaches;  // [frame index]
+    uint64_t m_drawCommandGeneration = 1;
+    uint32_t m_drawCommandRecordCount = 0;  // Cache misses
     
     // synchronization primitives
-    std::vector<VkSemaphore> m_acquireImageSemaphores,
-        m_drawSemaphores,
-        m_computeCompleteSemaphores;
-    std::vector<VkFence> m_graphicInFlightFences,
-        m_computeInFlightFences;
+    std::vector<VkSemaphore> m_acquireImageSemaphores,  // Binary, the swapchain can't use timeline semaphores
+        m_drawSemaphores;
+    VkSemaphore m_graphicTimeline,  // Signaled with the frame serial once a frame's graphic work is done
+        m_computeTimeline;  // Signaled with the frame serial once the particles of that frame are simulated
+    uint64_t m_frameSerial = 0;  // Serial of the latest submitted frame, starts at 1
+    std::vector<bool> m_particleAcquirePending;  // Particle SSBO was released by the compute queue family, graphic has to acquire it
+
+    // timestamp queries, 4 per frame index: compute begin/end, graphic begin/end
+    VkQueryPool m_timestampQueryPool = VK_NULL_HANDLE;
+    uint64_t m_timestampMask;
+    std::vector<bool> m_timestampsWritten;  // Indexed by the graphic frame index the compute queries are paired with
+    double m_computeTimeTotal = 0.0,  // unit: milliseconds
+        m_graphicTimeTotal = 0.0,
+        m_overlapTimeTotal = 0.0;
+    uint32_t m_timestampSampleCount = 0;
+
+    // Dynamic resolution, set by --dynamic-resolution. The scene is rendered to the top left m_renderExtent of an 
+    // offscreen target and blitted up to the swapchain, the scale follows the GPU frame time toward the target
+    float m_targetFrameTime = 0.f;  // unit: milliseconds, 0 renders at the swapchain extent
+    float m_renderScale = 1.f;
+    float m_minRenderScale = 0.5f;
+    VkExtent2D m_renderExtent = {0, 0};
+    double m_renderScaleTotal = 0.0;
+    float m_renderScaleLowest = 1.f;
+    uint32_t m_renderScaleSampleCount = 0;
 
     struct UBOProjectionMatrices
     {
@@ -277,22 +532,37 @@ private:
         alignas(16) glm::mat4 projection;  // alignment:16B, size:64B
     };
 
+    struct UBODrawData
+    {
+        alignas(16) glm::mat4 model;  // alignment:16B, size:64B
+    };
+
     // Buffers and memories
     std::vector<VkBuffer> m_uniformBuffers;
     std::vector<VkDeviceMemory> m_uniformBufferMemories;
     std::vector<void*> m_uniformBuffersMapped;
+    VkBuffer m_drawDataRing;  // [frame index][object] UBODrawData, m_drawDataStride apart
+    VkDeviceMemory m_drawDataRingMemory;
+    void* m_drawDataRingMapped;
+    uint32_t m_drawDataStride;
 
-    // Depth resources
-    VkImage m_depthStencilImage;
-    VkImageView m_depthStencilImageView;
-    VkDeviceMemory m_depthStencilImageMemory;
+    // Frame passes, owns the MSAA and depth images as transient attachments
+    RenderGraph* m_renderGraph = VK_NULL_HANDLE;
     VkFormat m_depthStencilImageFormat;
 
-    // Color resources
-    VkImage m_colorMSAAImage;
-    VkImageView m_colorMSAAImageView;
-    VkDeviceMemory m_colorMSAAImageMemory;
-
-    // MSAA sample count
+    // MSAA sample count, set by --msaa and switched with M while running
     VkSampleCountFlagBits m_MSAASampleCount;
+    uint32_t m_requestedSampleCount = 0;  // 0 takes the highest the device supports
+    VkBool32 m_MSAAChangeRequested = VK_FALSE;
+    uint32_t m_MSAASweepFrames = 0;  // --msaa-sweep, frames drawn at each level before moving up
+    float m_sceneMinSampleShading = 0.25f,  // --min-sample-shading, 0 disables sample rate shading for the pass
+        m_particleMinSampleShading = 0.25f;
+    std::vector<VkSampleCountFlagBits> m_timestampSampleCounts;  // [frame index] sample count the timed frame was drawn with
+    std::map<VkSampleCountFlagBits, std::pair<double, uint32_t>> m_MSAAFrameTimes;  // Drawing time total(ms) and frames
+
+    // Size the MSAA and depth attachments are declared with, may be larger than the swapchain after a shrink
+    VkExtent2D m_attachmentExtent;
+
+    // Destructors to run once the graphic timeline reaches the frame serial they were queued at
+    mutable std::deque<std::pair<uint64_t, std::function<void()>>> m_deferredDestructions;
 };
\ No newline at end of file
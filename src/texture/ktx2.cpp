@@ -0,0 +1,170 @@
+#include "ktx2.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+    const uint8_t ktx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    // Identifier, the 9 uint32 header fields and the index of the dfd, kvd and sgd sections
+    const size_t headerSize = 12 + 9 * 4 + 4 * 4 + 2 * 8;
+    const size_t levelIndexEntrySize = 3 * 8;
+
+    template<typename T>
+    T readField(const std::vector<uint8_t>& bytes, size_t offset)
+    {
+        T value;
+        memcpy(&value, bytes.data() + offset, sizeof(T));
+        return value;
+    }
+
+    template<typename T>
+    void writeField(std::vector<uint8_t>& bytes, size_t offset, T value)
+    {
+        memcpy(bytes.data() + offset, &value, sizeof(T));
+    }
+
+    size_t levelSize(const TexelBlock& block, uint32_t width, uint32_t height)
+    {
+        return static_cast<size_t>((width + block.width - 1) / block.width) * 
+            ((height + block.height - 1) / block.height) * block.size;
+    }
+
+    // Basic data format descriptor (Khronos Data Format Specification 1.3) of a BC1 texture, one 64 bit sample
+    std::vector<uint32_t> bc1FormatDescriptor(VkFormat format)
+    {
+        const uint32_t modelBC1A = 128, primariesBT709 = 1, transferLinear = 1, transferSRGB = 2;
+        bool sRGB = format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+        bool alpha = format == VK_FORMAT_BC1_RGBA_UNORM_BLOCK || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+        return {
+            44,  // dfdTotalSize
+            0,  // vendorId and descriptorType, both Khronos basic
+            2 | (40u << 16),  // versionNumber, descriptorBlockSize
+            modelBC1A | (primariesBT709 << 8) | ((sRGB ? transferSRGB : transferLinear) << 16),
+            3 | (3u << 8),  // 4x4 texel blocks, stored minus one
+            8, 0,  // bytesPlane0..7
+            0 | (63u << 16) | ((alpha ? 1u : 0u) << 24),  // bitOffset, bitLength minus one, channelType
+            0, 0, UINT32_MAX};  // samplePosition, sampleLower, sampleUpper
+    }
+}
+
+bool getTexelBlock(VkFormat format, TexelBlock& block)
+{
+    if(format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB)
+        block = {1, 1, 4};
+    else if(format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK)
+    {
+        bool eightBytes = format <= VK_FORMAT_BC1_RGBA_SRGB_BLOCK || 
+            format == VK_FORMAT_BC4_UNORM_BLOCK || format == VK_FORMAT_BC4_SNORM_BLOCK;
+        block = {4, 4, eightBytes ? 8u : 16u};
+    }
+    else if(format >= VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && format <= VK_FORMAT_EAC_R11G11_SNORM_BLOCK)
+    {
+        bool sixteenBytes = format == VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK || format == VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK || 
+            format == VK_FORMAT_EAC_R11G11_UNORM_BLOCK || format == VK_FORMAT_EAC_R11G11_SNORM_BLOCK;
+        block = {4, 4, sixteenBytes ? 16u : 8u};
+    }
+    else if(format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK)
+    {
+        // UNORM and SRGB alternate, one pair per footprint
+        const uint32_t footprints[14][2] = {{4, 4}, {5, 4}, {5, 5}, {6, 5}, {6, 6}, {8, 5}, {8, 6}, {8, 8}, 
+            {10, 5}, {10, 6}, {10, 8}, {10, 10}, {12, 10}, {12, 12}};
+        const uint32_t* footprint = footprints[(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2];
+        block = {footprint[0], footprint[1], 16};
+    }
+    else
+        return false;
+    return true;
+}
+
+Ktx2Image readKtx2(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if(!file.is_open())
+        throw std::runtime_error("KTX2 ERROR: Failed to open " + filename + ".");
+    std::vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+
+    if(bytes.size() < headerSize || memcmp(bytes.data(), ktx2Identifier, sizeof(ktx2Identifier)) != 0)
+        throw std::runtime_error("KTX2 ERROR: " + filename + " is not a KTX2 file.");
+
+    Ktx2Image image;
+    image.format = static_cast<VkFormat>(readField<uint32_t>(bytes, 12));
+    image.width = readField<uint32_t>(bytes, 20);
+    image.height = readField<uint32_t>(bytes, 24);
+    uint32_t depth = readField<uint32_t>(bytes, 28), layerCount = readField<uint32_t>(bytes, 32), 
+        faceCount = readField<uint32_t>(bytes, 36), levelCount = readField<uint32_t>(bytes, 40), 
+        supercompressionScheme = readField<uint32_t>(bytes, 44);
+
+    TexelBlock block;
+    if(!getTexelBlock(image.format, block))
+        throw std::runtime_error("KTX2 ERROR: " + filename + " uses unsupported VkFormat " + 
+            std::to_string(image.format) + ".");
+    if(supercompressionScheme != 0)
+        throw std::runtime_error("KTX2 ERROR: " + filename + " is supercompressed.");
+    if(image.width == 0 || image.height == 0 || depth > 1 || layerCount > 1 || faceCount != 1)
+        throw std::runtime_error("KTX2 ERROR: " + filename + " is not a single 2D image.");
+    // A level count of 0 asks the loader to generate the mips, which block compressed formats can't be blitted for
+    levelCount = std::max(levelCount, 1u);
+    if(bytes.size() < headerSize + levelCount * levelIndexEntrySize)
+        throw std::runtime_error("KTX2 ERROR: " + filename + " is truncated.");
+
+    image.levels.resize(levelCount);
+    for(uint32_t level = 0; level < levelCount; ++level)
+    {
+        size_t entry = headerSize + level * levelIndexEntrySize;
+        uint64_t byteOffset = readField<uint64_t>(bytes, entry), byteLength = readField<uint64_t>(bytes, entry + 8);
+        uint32_t levelWidth = std::max(image.width >> level, 1u), levelHeight = std::max(image.height >> level, 1u);
+        if(byteLength != levelSize(block, levelWidth, levelHeight) || byteOffset + byteLength > bytes.size())
+            throw std::runtime_error("KTX2 ERROR: " + filename + " has a malformed level " + std::to_string(level) + ".");
+        image.levels[level].assign(bytes.begin() + byteOffset, bytes.begin() + byteOffset + byteLength);
+    }
+    return image;
+}
+
+void writeKtx2(const std::string& filename, const Ktx2Image& image)
+{
+    TexelBlock block;
+    if(image.format < VK_FORMAT_BC1_RGB_UNORM_BLOCK || image.format > VK_FORMAT_BC1_RGBA_SRGB_BLOCK || 
+        !getTexelBlock(image.format, block))
+        throw std::runtime_error("KTX2 ERROR: Only BC1 formats can be written.");
+
+    std::vector<uint32_t> formatDescriptor = bc1FormatDescriptor(image.format);
+    uint32_t levelCount = static_cast<uint32_t>(image.levels.size());
+    size_t dfdOffset = headerSize + levelCount * levelIndexEntrySize, 
+        dfdSize = formatDescriptor.size() * sizeof(uint32_t);
+
+    std::vector<uint8_t> bytes(dfdOffset + dfdSize);
+    memcpy(bytes.data(), ktx2Identifier, sizeof(ktx2Identifier));
+    writeField<uint32_t>(bytes, 12, image.format);
+    writeField<uint32_t>(bytes, 16, 1);  // typeSize, 1 for block compressed formats
+    writeField<uint32_t>(bytes, 20, image.width);
+    writeField<uint32_t>(bytes, 24, image.height);
+    writeField<uint32_t>(bytes, 36, 1);  // faceCount
+    writeField<uint32_t>(bytes, 40, levelCount);
+    writeField<uint32_t>(bytes, 48, static_cast<uint32_t>(dfdOffset));
+    writeField<uint32_t>(bytes, 52, static_cast<uint32_t>(dfdSize));
+    memcpy(bytes.data() + dfdOffset, formatDescriptor.data(), dfdSize);
+
+    // Levels are stored smallest first, each aligned to lcm(block size, 4)
+    for(uint32_t level = levelCount; level-- > 0;)
+    {
+        size_t offset = (bytes.size() + block.size - 1) / block.size * block.size;
+        bytes.resize(offset);
+        bytes.insert(bytes.end(), image.levels[level].begin(), image.levels[level].end());
+
+        size_t entry = headerSize + level * levelIndexEntrySize;
+        writeField<uint64_t>(bytes, entry, offset);
+        writeField<uint64_t>(bytes, entry + 8, image.levels[level].size());
+        writeField<uint64_t>(bytes, entry + 16, image.levels[level].size());
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if(!file.is_open())
+        throw std::runtime_error("KTX2 ERROR: Failed to open " + filename + " for writing.");
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+# pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// A KTX2 texture with its complete mip chain, level 0 being the full size one. Only 2D, single layer and face, not
+// supercompressed files are handled, which is what the offline converter (src/tools) writes.
+struct Ktx2Image
+{
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0, height = 0;
+    std::vector<std::vector<uint8_t>> levels;
+};
+
+// Throws "KTX2 ERROR: ..." if the file can't be read or uses a layout listed above as unsupported
+Ktx2Image readKtx2(const std::string& filename);
+// Writes the levels smallest first as the spec asks for. The data format descriptor is only known for BC1 formats.
+void writeKtx2(const std::string& filename, const Ktx2Image& image);
+
+// Block dimensions and bytes per block of the block compressed formats the loader can upload, {1, 1, 4} for RGBA8
+struct TexelBlock
+{
+    uint32_t width, height, size;
+};
+bool getTexelBlock(VkFormat format, TexelBlock& block);
\ No newline at end of file
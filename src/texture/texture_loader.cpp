@@ -0,0 +1,350 @@
+#include "texture_loader.h"
+#include "../resources.h"
+#include "../thread/thread_pool.h"
+
+#include <stb_image.h>
+
+#include <stdexcept>
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+    // Covers the texel block size of every uploadable format and the 4 byte alignment copies need
+    const VkDeviceSize stagingAlignment = 16;
+
+    VkDeviceSize alignStaging(VkDeviceSize offset)
+    {
+        return (offset + stagingAlignment - 1) / stagingAlignment * stagingAlignment;
+    }
+}
+
+TextureLoader::TextureLoader(VkDevice device, uint32_t queueFamily, uint32_t threadCount, VkDeviceSize stagingCapacity):
+    m_device(device), 
+    m_stagingCapacity(stagingCapacity)
+{
+    if(threadCount != 0)
+        m_threadPool = new ThreadPool(threadCount);
+
+    VkCommandPoolCreateInfo commandPoolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,  // Reset as a whole after every submission
+        .queueFamilyIndex = queueFamily
+    };
+    if(vkCreateCommandPool(m_device, &commandPoolCreateInfo, VK_NULL_HANDLE, &m_commandPool) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to create texture upload command pool.");
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = m_commandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1
+    };
+    if(vkAllocateCommandBuffers(m_device, &commandBufferAllocateInfo, &m_commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to allocate texture upload command buffer.");
+    VkFenceCreateInfo fenceCreateInfo = {.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    if(vkCreateFence(m_device, &fenceCreateInfo, VK_NULL_HANDLE, &m_fence) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to create texture upload fence.");
+}
+
+uint32_t TextureLoader::threadCount() const
+{
+    return m_threadPool != nullptr ? m_threadPool->threadCount() : 0;
+}
+
+void TextureLoader::load(const std::vector<const char*>& filenames, Callback onComplete)
+{
+    auto loadStart = std::chrono::steady_clock::now();
+    uint32_t textureCount = static_cast<uint32_t>(filenames.size());
+    if(m_threadPool != nullptr)
+    {
+        for(uint32_t i = 0; i < textureCount; ++i)
+        {
+            m_threadPool->enqueue([this, i, filename = filenames[i]](uint32_t)
+            {
+                Decoded decoded = decode(i, filename);
+                {
+                    std::lock_guard<std::mutex> lock(m_decodedMutex);
+                    m_decoded.push(std::move(decoded));
+                }
+                m_decodedReady.notify_one();
+            });
+        }
+    }
+
+    // Uploads happen in the order decoding finishes, recording overlaps with the files still being decoded
+    std::vector<Texture> textures(textureCount);
+    std::vector<uint32_t> uploaded;
+    std::exception_ptr exception;
+    VkDeviceSize stagedSize = 0;
+    m_submissionCount = 0;
+    while(uploaded.size() < textureCount)
+    {
+        Decoded decoded;
+        if(m_threadPool != nullptr)
+        {
+            std::unique_lock<std::mutex> lock(m_decodedMutex);
+            m_decodedReady.wait(lock, [this]() { return !m_decoded.empty(); });
+            decoded = std::move(m_decoded.front());
+            m_decoded.pop();
+        }
+        else
+            decoded = decode(static_cast<uint32_t>(uploaded.size()), filenames[uploaded.size()]);
+
+        // Decode workers leave their messages to the loading thread so lines of different files don't interleave
+        for(const std::string& message: decoded.messages)
+            std::cout << "VK INFO: " << message << "\n";
+
+        try
+        {
+            if(decoded.exception)
+                std::rethrow_exception(decoded.exception);
+            Texture& texture = textures[decoded.index];
+            upload(decoded, texture);
+            texture.path = filenames[decoded.index];
+            uploaded.push_back(decoded.index);
+            for(const std::vector<uint8_t>& level: decoded.image.levels)
+                stagedSize += level.size();
+        }
+        catch(...)
+        {
+            // upload() may have created part of the texture before throwing, it's cleaned up with the uploaded ones
+            if(!decoded.exception)
+                uploaded.push_back(decoded.index);
+            exception = std::current_exception();
+            break;
+        }
+
+        if(decoded.source != filenames[decoded.index])
+        {
+            // The RGBA8 path's full mip chain takes 4/3 of its top level
+            VkDeviceSize compressedSize = 0;
+            for(const std::vector<uint8_t>& level: decoded.image.levels)
+                compressedSize += level.size();
+            std::cout << "VK INFO: Loaded " << decoded.source << ", " << decoded.image.levels.size() << " mip levels, " << 
+                compressedSize / 1024 << " KiB instead of " << 4ull * decoded.image.width * decoded.image.height * 4 / 3 / 1024 << 
+                " KiB as RGBA8.\n";
+        }
+    }
+
+    if(exception)
+    {
+        // Let the remaining decodes finish before dropping them and whatever was uploaded so far
+        if(m_threadPool != nullptr)
+            m_threadPool->wait();
+        m_decoded = {};
+        if(m_recording)
+        {
+            vkEndCommandBuffer(m_commandBuffer);
+            vkResetCommandPool(m_device, m_commandPool, 0);
+            m_recording = false;
+        }
+        m_stagingOffset = 0;
+        Resources* resources = Resources::get();
+        for(uint32_t index: uploaded)
+            resources->cleanUpTexture(textures[index]);
+        std::rethrow_exception(exception);
+    }
+    if(m_recording)
+        submitBatch();
+
+    double loadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+    std::cout << "VK INFO: Loaded " << textureCount << (textureCount == 1 ? " texture in " : " textures in ") << loadTime << 
+        " ms, " << threadCount() << " decode threads, " << m_submissionCount << " submissions, " << 
+        stagedSize / (1024.0 * 1024.0) << " MiB staged.\n";
+    onComplete(textures);
+}
+
+TextureLoader::Decoded TextureLoader::decode(uint32_t index, const char* filename) const
+{
+    Decoded decoded;
+    decoded.index = index;
+    try
+    {
+        // "x.png" may come with pre-baked variants "x.bc7.ktx2", "x.astc.ktx2", "x.bc1.ktx2" or "x.ktx2", the first
+        // one the device can sample is uploaded as is, mips included
+        Resources* resources = Resources::get();
+        if(resources->compressedTexturesEnabled())
+        {
+            for(const char* extension: {".bc7.ktx2", ".astc.ktx2", ".bc1.ktx2", ".ktx2"})
+            {
+                std::filesystem::path candidate = filename;
+                candidate.replace_extension(extension);
+                if(!std::filesystem::exists(candidate))
+                    continue;
+                Ktx2Image ktx2;
+                try
+                {
+                    ktx2 = readKtx2(candidate.string());
+                }
+                catch(const std::runtime_error& e)
+                {
+                    decoded.messages.push_back(std::string(e.what()) + " Skipped.");
+                    continue;
+                }
+                if(!resources->isTextureFormatSupported(ktx2.format))
+                {
+                    decoded.messages.push_back(candidate.string() + " skipped, VkFormat " + std::to_string(ktx2.format) + 
+                        " is not supported by the device.");
+                    continue;
+                }
+                decoded.image = std::move(ktx2);
+                decoded.source = candidate.string();
+                return decoded;
+            }
+        }
+
+        int imageWidth, imageHeight, imageChannels;
+        stbi_uc* data = stbi_load(filename, &imageWidth, &imageHeight, &imageChannels, STBI_rgb_alpha);
+        if(!data)
+            throw std::runtime_error(std::string("STBI ERROR: Failed to load image ") + filename + ".");
+        decoded.image.format = VK_FORMAT_R8G8B8A8_SRGB;
+        decoded.image.width = static_cast<uint32_t>(imageWidth);
+        decoded.image.height = static_cast<uint32_t>(imageHeight);
+        decoded.image.levels.emplace_back(data, data + 4 * static_cast<size_t>(imageWidth) * imageHeight);
+        stbi_image_free(data);
+        decoded.source = filename;
+        decoded.generateMips = true;
+    }
+    catch(...)
+    {
+        decoded.exception = std::current_exception();
+    }
+    return decoded;
+}
+
+void TextureLoader::upload(const Decoded& decoded, Texture& texture)
+{
+    Resources* resources = Resources::get();
+    const Ktx2Image& image = decoded.image;
+
+    VkDeviceSize size = 0;
+    for(const std::vector<uint8_t>& level: image.levels)
+        size = alignStaging(size) + level.size();
+    reserveStaging(size);
+    if(!m_recording)
+        beginBatch();
+
+    texture.mipLevels = decoded.generateMips ? 
+        static_cast<uint32_t>(std::floor(std::log2(std::max(image.width, image.height)))) + 1 : 
+        static_cast<uint32_t>(image.levels.size());
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | 
+        (decoded.generateMips ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+    resources->createImage(image.width, image.height, image.format, usage, texture.mipLevels, VK_SAMPLE_COUNT_1_BIT, 
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.imageMemory);
+
+    std::vector<VkBufferImageCopy> regions;
+    for(uint32_t level = 0; level < image.levels.size(); ++level)
+    {
+        m_stagingOffset = alignStaging(m_stagingOffset);
+        memcpy(m_stagingMapped + m_stagingOffset, image.levels[level].data(), image.levels[level].size());
+        regions.push_back({
+            .bufferOffset = m_stagingOffset,
+            .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},
+            .imageExtent = {std::max(image.width >> level, 1u), std::max(image.height >> level, 1u), 1}});
+        m_stagingOffset += image.levels[level].size();
+    }
+
+    VkImageMemoryBarrier imageMemoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = texture.image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, 1}
+    };
+    vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 
+        0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &imageMemoryBarrier);
+    vkCmdCopyBufferToImage(m_commandBuffer, m_stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
+        static_cast<uint32_t>(regions.size()), regions.data());
+
+    if(decoded.generateMips)
+        resources->cmdGenerateMipmaps(m_commandBuffer, texture.image, image.format, image.width, image.height, texture.mipLevels);
+    else
+    {
+        imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 
+            0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &imageMemoryBarrier);
+    }
+
+    resources->createImageView(texture.imageView, texture.image, image.format, VK_IMAGE_ASPECT_COLOR_BIT, texture.mipLevels);
+    resources->createSampler(texture.sampler, texture.mipLevels);
+}
+
+void TextureLoader::reserveStaging(VkDeviceSize size)
+{
+    if(m_stagingBuffer != VK_NULL_HANDLE && alignStaging(m_stagingOffset) + size <= m_stagingCapacity)
+        return;
+    // Full, the recorded copies have to finish before the ring can be rewound
+    if(m_recording)
+        submitBatch();
+    if(m_stagingBuffer != VK_NULL_HANDLE && size <= m_stagingCapacity)
+        return;
+
+    // A texture larger than the whole ring grows it, nothing is in flight at this point
+    if(m_stagingBuffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(m_device, m_stagingBuffer, VK_NULL_HANDLE);
+        vkFreeMemory(m_device, m_stagingMemory, VK_NULL_HANDLE);
+    }
+    m_stagingCapacity = std::max(m_stagingCapacity, size);
+    Resources::get()->createBuffer(m_stagingCapacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
+        m_stagingBuffer, m_stagingMemory);
+    if(vkMapMemory(m_device, m_stagingMemory, 0, m_stagingCapacity, 0, reinterpret_cast<void**>(&m_stagingMapped)) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to map texture staging ring.");
+    m_stagingOffset = 0;
+}
+
+void TextureLoader::beginBatch()
+{
+    VkCommandBufferBeginInfo commandBufferBeginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+    if(vkBeginCommandBuffer(m_commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to begin texture upload command buffer.");
+    m_recording = true;
+}
+
+void TextureLoader::submitBatch()
+{
+    if(vkEndCommandBuffer(m_commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to end texture upload command buffer.");
+    m_recording = false;
+
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &m_commandBuffer
+    };
+    if(vkQueueSubmit(Resources::get()->graphicQueue(), 1, &submitInfo, m_fence) != VK_SUCCESS)
+        throw std::runtime_error("VK ERROR: Failed to submit texture uploads.");
+    vkWaitForFences(m_device, 1, &m_fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(m_device, 1, &m_fence);
+    vkResetCommandPool(m_device, m_commandPool, 0);
+    m_stagingOffset = 0;
+    ++m_submissionCount;
+}
+
+void TextureLoader::cleanUp()
+{
+    delete m_threadPool;
+    m_threadPool = nullptr;
+    if(m_stagingBuffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(m_device, m_stagingBuffer, VK_NULL_HANDLE);
+        vkFreeMemory(m_device, m_stagingMemory, VK_NULL_HANDLE);
+    }
+    vkDestroyFence(m_device, m_fence, VK_NULL_HANDLE);
+    vkDestroyCommandPool(m_device, m_commandPool, VK_NULL_HANDLE);
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+# pragma once
+
+#include "../model/texture.h"
+#include "ktx2.h"
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <queue>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+class ThreadPool;
+
+// Loads batches of textures: files are decoded (PNG through stb_image, or a pre-baked KTX2 variant) on a thread pool
+// while the loading thread streams each finished one into a persistently mapped staging ring and records its copy and
+// mip generation. A submission is only made when the ring is full and once at the end, so a batch of small textures
+// costs a single vkQueueSubmit. load() returns once the GPU is done and onComplete has been called with the textures.
+class TextureLoader
+{
+public:
+    using Callback = std::function<void(std::vector<Texture>& textures)>;
+
+    // threadCount 0 decodes on the loading thread
+    TextureLoader(VkDevice device, uint32_t queueFamily, uint32_t threadCount, VkDeviceSize stagingCapacity);
+    // The textures keep the filename pointers as their path, they have to outlive them
+    void load(const std::vector<const char*>& filenames, Callback onComplete);
+    void cleanUp();
+    uint32_t threadCount() const;
+private:
+    // A decoded file, either one RGBA8 level that gets its mips blitted or every level of a KTX2 file
+    struct Decoded
+    {
+        uint32_t index;
+        Ktx2Image image;
+        std::string source;  // File the texels came from, the PNG or its KTX2 variant
+        bool generateMips = false;
+        std::vector<std::string> messages;  // Printed by the loading thread
+        std::exception_ptr exception;
+    };
+
+    Decoded decode(uint32_t index, const char* filename) const;
+    void upload(const Decoded& decoded, Texture& texture);
+    void reserveStaging(VkDeviceSize size);
+    void beginBatch();
+    void submitBatch();
+
+    VkDevice m_device;
+    ThreadPool* m_threadPool = nullptr;
+    std::mutex m_decodedMutex;
+    std::condition_variable m_decodedReady;
+    std::queue<Decoded> m_decoded;
+
+    // Staging ring, rewound after every submission has been waited for
+    VkBuffer m_stagingBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_stagingMemory = VK_NULL_HANDLE;
+    uint8_t* m_stagingMapped = nullptr;
+    VkDeviceSize m_stagingCapacity, 
+        m_stagingOffset = 0;
+
+    VkCommandPool m_commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer m_commandBuffer = VK_NULL_HANDLE;
+    bool m_recording = false;  // The batch has uploads that are not submitted yet
+    VkFence m_fence = VK_NULL_HANDLE;
+    uint32_t m_submissionCount = 0;  // Of the current load()
+};
\ No newline at end of file
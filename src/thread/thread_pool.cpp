@@ -0,0 +1,73 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    for(uint32_t i = 0; i < threadCount; ++i)
+        m_threads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_jobAvailable.notify_all();
+    for(std::thread& thread: m_threads)
+        thread.join();
+}
+
+void ThreadPool::enqueue(Job job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push(std::move(job));
+    }
+    m_jobAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_jobsDone.wait(lock, [this]() { return m_jobs.empty() && m_activeJobCount == 0; });
+    if(m_jobException)
+    {
+        std::exception_ptr jobException = m_jobException;
+        m_jobException = nullptr;
+        std::rethrow_exception(jobException);
+    }
+}
+
+void ThreadPool::workerLoop(uint32_t threadIndex)
+{
+    while(true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobAvailable.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+            if(m_stopping && m_jobs.empty())
+                return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop();
+            ++m_activeJobCount;
+        }
+
+        try
+        {
+            job(threadIndex);
+        }
+        catch(...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(!m_jobException)
+                m_jobException = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_activeJobCount;
+        }
+        m_jobsDone.notify_all();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+# pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+class ThreadPool
+{
+public:
+    // Jobs get the index of the worker running them, so they can use per-thread resources such as command pools
+    using Job = std::function<void(uint32_t threadIndex)>;
+
+    explicit ThreadPool(uint32_t threadCount);
+    ~ThreadPool();
+    void enqueue(Job job);
+    void wait();  // Blocks until every enqueued job has finished, rethrows the first exception a job threw
+    uint32_t threadCount() const { return static_cast<uint32_t>(m_threads.size()); }
+private:
+    void workerLoop(uint32_t threadIndex);
+
+    std::vector<std::thread> m_threads;
+    std::queue<Job> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_jobAvailable,
+        m_jobsDone;
+    uint32_t m_activeJobCount = 0;
+    bool m_stopping = false;
+    std::exception_ptr m_jobException;
+};
\ No newline at end of file
@@ -0,0 +1,190 @@
+// Offline converter turning a PNG (or anything stb_image reads) into a BC1 KTX2 with its full mip chain, e.g.
+// TextureConverter ./textures/viking_room.png writes ./textures/viking_room.bc1.ktx2 which the renderer then prefers
+#include "../texture/ktx2.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <iostream>
+#include <filesystem>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+
+namespace
+{
+    struct Rgba8Image
+    {
+        uint32_t width, height;
+        std::vector<uint8_t> texels;
+
+        const uint8_t* at(uint32_t x, uint32_t y) const
+        {
+            return texels.data() + 4 * (static_cast<size_t>(std::min(y, height - 1)) * width + std::min(x, width - 1));
+        }
+    };
+
+    float sRGBToLinear(uint8_t value)
+    {
+        float c = value / 255.f;
+        return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    uint8_t linearToSRGB(float c)
+    {
+        c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+        return static_cast<uint8_t>(std::clamp(c, 0.f, 1.f) * 255.f + 0.5f);
+    }
+
+    // 2x2 box filter, averaging color in linear space and alpha as is
+    Rgba8Image downsample(const Rgba8Image& source)
+    {
+        Rgba8Image result = {std::max(source.width / 2, 1u), std::max(source.height / 2, 1u), {}};
+        result.texels.resize(4 * static_cast<size_t>(result.width) * result.height);
+        for(uint32_t y = 0; y < result.height; ++y)
+        {
+            for(uint32_t x = 0; x < result.width; ++x)
+            {
+                const uint8_t* quad[4] = {source.at(2 * x, 2 * y), source.at(2 * x + 1, 2 * y), 
+                    source.at(2 * x, 2 * y + 1), source.at(2 * x + 1, 2 * y + 1)};
+                uint8_t* texel = result.texels.data() + 4 * (static_cast<size_t>(y) * result.width + x);
+                for(int channel = 0; channel < 3; ++channel)
+                {
+                    float sum = 0.f;
+                    for(const uint8_t* sample: quad) sum += sRGBToLinear(sample[channel]);
+                    texel[channel] = linearToSRGB(sum / 4.f);
+                }
+                texel[3] = static_cast<uint8_t>((quad[0][3] + quad[1][3] + quad[2][3] + quad[3][3] + 2) / 4);
+            }
+        }
+        return result;
+    }
+
+    uint16_t packRGB565(const float color[3])
+    {
+        auto quantize = [](float c, int max) { return static_cast<uint16_t>(std::clamp(c / 255.f * max + 0.5f, 0.f, static_cast<float>(max))); };
+        return static_cast<uint16_t>((quantize(color[0], 31) << 11) | (quantize(color[1], 63) << 5) | quantize(color[2], 31));
+    }
+
+    void unpackRGB565(uint16_t packed, float color[3])
+    {
+        color[0] = ((packed >> 11) & 31) * 255.f / 31.f;
+        color[1] = ((packed >> 5) & 63) * 255.f / 63.f;
+        color[2] = (packed & 31) * 255.f / 31.f;
+    }
+
+    // Endpoints are the corners of the block's color bounding box, inset by 1/16 of its size to reduce the error at
+    // the interior palette entries. Always four color mode, the source is treated as opaque.
+    void encodeBC1Block(const Rgba8Image& image, uint32_t blockX, uint32_t blockY, uint8_t* output)
+    {
+        float texels[16][3], minColor[3] = {255.f, 255.f, 255.f}, maxColor[3] = {0.f, 0.f, 0.f};
+        for(uint32_t i = 0; i < 16; ++i)
+        {
+            const uint8_t* texel = image.at(4 * blockX + i % 4, 4 * blockY + i / 4);
+            for(int channel = 0; channel < 3; ++channel)
+            {
+                texels[i][channel] = texel[channel];
+                minColor[channel] = std::min(minColor[channel], texels[i][channel]);
+                maxColor[channel] = std::max(maxColor[channel], texels[i][channel]);
+            }
+        }
+        for(int channel = 0; channel < 3; ++channel)
+        {
+            float inset = (maxColor[channel] - minColor[channel]) / 16.f;
+            minColor[channel] += inset;
+            maxColor[channel] -= inset;
+        }
+
+        uint16_t color0 = packRGB565(maxColor), color1 = packRGB565(minColor);
+        if(color0 < color1) std::swap(color0, color1);
+        float palette[4][3];
+        unpackRGB565(color0, palette[0]);
+        unpackRGB565(color1, palette[1]);
+        for(int channel = 0; channel < 3; ++channel)
+        {
+            palette[2][channel] = (2.f * palette[0][channel] + palette[1][channel]) / 3.f;
+            palette[3][channel] = (palette[0][channel] + 2.f * palette[1][channel]) / 3.f;
+        }
+
+        uint32_t indices = 0;
+        if(color0 != color1)  // Equal endpoints would select three color mode, index 0 is right for every texel then
+        {
+            for(uint32_t i = 0; i < 16; ++i)
+            {
+                uint32_t best = 0;
+                float bestDistance = INFINITY;
+                for(uint32_t entry = 0; entry < 4; ++entry)
+                {
+                    float distance = 0.f;
+                    for(int channel = 0; channel < 3; ++channel)
+                        distance += (texels[i][channel] - palette[entry][channel]) * (texels[i][channel] - palette[entry][channel]);
+                    if(distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        best = entry;
+                    }
+                }
+                indices |= best << (2 * i);
+            }
+        }
+        memcpy(output, &color0, 2);
+        memcpy(output + 2, &color1, 2);
+        memcpy(output + 4, &indices, 4);
+    }
+
+    std::vector<uint8_t> encodeBC1(const Rgba8Image& image)
+    {
+        uint32_t blocksX = (image.width + 3) / 4, blocksY = (image.height + 3) / 4;
+        std::vector<uint8_t> blocks(8 * static_cast<size_t>(blocksX) * blocksY);
+        for(uint32_t y = 0; y < blocksY; ++y)
+            for(uint32_t x = 0; x < blocksX; ++x)
+                encodeBC1Block(image, x, y, blocks.data() + 8 * (static_cast<size_t>(y) * blocksX + x));
+        return blocks;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2 || argc > 3)
+    {
+        std::cerr << "Usage: TextureConverter <input.png> [output.ktx2]\n";
+        return EXIT_FAILURE;
+    }
+    std::filesystem::path input = argv[1], output = input;
+    if(argc == 3) output = argv[2];
+    else output.replace_extension(".bc1.ktx2");
+
+    try
+    {
+        int width, height, channels;
+        stbi_uc* data = stbi_load(input.string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        if(!data)
+            throw std::runtime_error("STBI ERROR: Failed to load image.");
+        Rgba8Image level = {static_cast<uint32_t>(width), static_cast<uint32_t>(height), 
+            std::vector<uint8_t>(data, data + 4 * static_cast<size_t>(width) * height)};
+        stbi_image_free(data);
+
+        // Textures are sampled as sRGB, the same as the R8G8B8A8_SRGB images the renderer creates from PNGs
+        Ktx2Image ktx2 = {VK_FORMAT_BC1_RGB_SRGB_BLOCK, level.width, level.height, {}};
+        while(true)
+        {
+            ktx2.levels.push_back(encodeBC1(level));
+            if(level.width == 1 && level.height == 1) break;
+            level = downsample(level);
+        }
+        writeKtx2(output.string(), ktx2);
+
+        size_t compressedSize = 0;
+        for(const std::vector<uint8_t>& blocks: ktx2.levels) compressedSize += blocks.size();
+        std::cout << "Wrote " << output.string() << ": " << width << "x" << height << " BC1, " << ktx2.levels.size() << 
+            " mip levels, " << compressedSize / 1024 << " KiB\n";
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
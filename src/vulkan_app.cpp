@@ -9,15 +9,17 @@
 
 #include "resources.h"
 
-void VulkanApp::run()
+void VulkanApp::run(int argc, char** argv)
 {
     m_appResources = Resources::get();
     
+    m_appResources->parseCommandLineArguments(argc, argv);
     m_appResources->distributeResources();
     m_appResources->initWindow();
     initVulkan();
     m_appResources->mainLoop();
     m_appResources->cleanUp();
+    m_appResources->reportCapturedImage();
 }
 
 void VulkanApp::initVulkan()
@@ -32,21 +34,22 @@ void VulkanApp::initVulkan()
 
     m_appResources->createSwapChain();
     m_appResources->createSwapChainImageViews();
-    m_appResources->createColorResources();
-    m_appResources->createDepthResources();
+    m_appResources->createRenderGraph();
 
     m_appResources->createCommandPool();
     m_appResources->allocateCommandBuffers();
 
     m_appResources->createDescriptorSetLayout();
-    m_appResources->createRenderPass();
     m_appResources->createPipelineCache();
+    m_appResources->createPipelineManager();
     m_appResources->createPipeline();
-    m_appResources->createSwapChainFrameBuffers();
 
     m_appResources->createSyncObjects();
+    m_appResources->createTimestampQueryPool();
 
-    m_appResources->createDescriptorPool();
+    m_appResources->createDescriptorAllocators();
+    m_appResources->createBindlessDescriptorSet();
+    m_appResources->createTextureLoader();
     m_appResources->loadModel();
     m_appResources->loadParticles();
     m_appResources->createDrawUniformBuffers();
@@ -13,7 +13,7 @@ class Resources;
 class VulkanApp
 {
 public:
-    void run();
+    void run(int argc, char** argv);
 private:
     void initVulkan();
     
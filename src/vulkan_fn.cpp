@@ -4,6 +4,9 @@
 
 PFN_vkCreateDebugUtilsMessengerEXT vulkan_createDebugUtilsMessengerEXT = nullptr;
 PFN_vkDestroyDebugUtilsMessengerEXT vulkan_destroyDebugUtilsMessengerEXT = nullptr;
+PFN_vkCmdBeginRenderingKHR vulkan_cmdBeginRenderingKHR = nullptr;
+PFN_vkCmdEndRenderingKHR vulkan_cmdEndRenderingKHR = nullptr;
+PFN_vkCmdPipelineBarrier2KHR vulkan_cmdPipelineBarrier2KHR = nullptr;
 
 VkResult load_vkInstanceFunctions(const VkInstance& instance, VkBool32 enableValdation)
 {
@@ -16,4 +19,17 @@ VkResult load_vkInstanceFunctions(const VkInstance& instance, VkBool32 enableVal
         if(!vulkan_destroyDebugUtilsMessengerEXT) return VK_ERROR_EXTENSION_NOT_PRESENT;
     }
     return VK_SUCCESS;
+}
+
+VkResult load_vkDeviceFunctions(const VkDevice& device)
+{
+    vulkan_cmdBeginRenderingKHR = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR");
+    if(!vulkan_cmdBeginRenderingKHR) return VK_ERROR_EXTENSION_NOT_PRESENT;
+
+    vulkan_cmdEndRenderingKHR = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR");
+    if(!vulkan_cmdEndRenderingKHR) return VK_ERROR_EXTENSION_NOT_PRESENT;
+
+    vulkan_cmdPipelineBarrier2KHR = (PFN_vkCmdPipelineBarrier2KHR)vkGetDeviceProcAddr(device, "vkCmdPipelineBarrier2KHR");
+    if(!vulkan_cmdPipelineBarrier2KHR) return VK_ERROR_EXTENSION_NOT_PRESENT;
+    return VK_SUCCESS;
 }
\ No newline at end of file
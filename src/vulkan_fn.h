@@ -6,5 +6,12 @@ extern PFN_vkCreateDebugUtilsMessengerEXT vulkan_createDebugUtilsMessengerEXT;
 #define vkCreateDebugUtilsMessengerEXT vulkan_createDebugUtilsMessengerEXT
 extern PFN_vkDestroyDebugUtilsMessengerEXT vulkan_destroyDebugUtilsMessengerEXT;
 #define vkDestroyDebugUtilsMessengerEXT vulkan_destroyDebugUtilsMessengerEXT
+extern PFN_vkCmdBeginRenderingKHR vulkan_cmdBeginRenderingKHR;
+#define vkCmdBeginRenderingKHR vulkan_cmdBeginRenderingKHR
+extern PFN_vkCmdEndRenderingKHR vulkan_cmdEndRenderingKHR;
+#define vkCmdEndRenderingKHR vulkan_cmdEndRenderingKHR
+extern PFN_vkCmdPipelineBarrier2KHR vulkan_cmdPipelineBarrier2KHR;
+#define vkCmdPipelineBarrier2KHR vulkan_cmdPipelineBarrier2KHR
 
-VkResult load_vkInstanceFunctions(const VkInstance& instance, VkBool32 enableValdation);
\ No newline at end of file
+VkResult load_vkInstanceFunctions(const VkInstance& instance, VkBool32 enableValdation);
+VkResult load_vkDeviceFunctions(const VkDevice& device);
\ No newline at end of file
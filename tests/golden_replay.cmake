@@ -0,0 +1,11 @@
+# Run by ctest as: cmake -DRENDERER=... -DLAUNCHER=... -DARGS=... -DGOLDEN_IMAGE=... -P golden_replay.cmake
+if(NOT EXISTS ${GOLDEN_IMAGE})
+    message("GOLDEN SKIPPED: No golden image at ${GOLDEN_IMAGE}, build the golden target on the driver the test runs on and commit it.")
+    return()
+endif()
+
+execute_process(COMMAND ${LAUNCHER} ${RENDERER} ${ARGS} --golden ${GOLDEN_IMAGE}
+    RESULT_VARIABLE RESULT)
+if(NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "GOLDEN FAILED: VulkanRenderer exited with ${RESULT}.")
+endif()
\ No newline at end of file